@@ -5,6 +5,8 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <limits>
 
 #include "binary.hpp"
 #include "serde.hpp"
@@ -15,30 +17,105 @@ namespace serde {
 constexpr size_t BCS_MAX_LENGTH = (1ull << 31) - 1;
 constexpr size_t BCS_MAX_CONTAINER_DEPTH = 500;
 
-class BcsSerializer : public BinarySerializer<BcsSerializer> {
-    using Parent = BinarySerializer<BcsSerializer>;
+// Sizes used by BCS for lengths and variant indices (ULEB128), see
+// `encoded_size_bounds`.
+struct BcsEncoding {
+    static constexpr SizeBounds len = {1, 5};
+    static constexpr SizeBounds variant_index = {1, 5};
+    // Indices below 128 are encoded with a single byte.
+    static constexpr size_t ordered_variant_count = 128;
+    // Values are compared like their BCS encodings by `compare_encodings`.
+    static constexpr bool is_ordered_by_compare_encodings = true;
+    // Floats cannot be serialized.
+    static constexpr bool has_floats = false;
+};
+
+template <class Sink = VectorSink>
+class BasicBcsSerializer
+    : public BinarySerializer<BasicBcsSerializer<Sink>, Sink> {
+    using Parent = BinarySerializer<BasicBcsSerializer<Sink>, Sink>;
+
+    template <class>
+    friend class BasicBcsSerializer;
+
+    // Start offsets of the map entries being serialized, for all the maps
+    // currently nested. Together with `sort_entries_` and `sort_scratch_`,
+    // this memory is re-used from one map to the next.
+    std::vector<size_t> entry_offsets_;
+    struct SortEntry {
+        // The first 8 bytes of the entry, as a big-endian integer. Most
+        // comparisons are decided by this prefix.
+        uint64_t prefix;
+        size_t start;
+        size_t len;
+    };
+    std::vector<SortEntry> sort_entries_;
+    std::vector<uint8_t> sort_scratch_;
 
     void serialize_u32_as_uleb128(uint32_t);
+    bool are_last_entries_increasing(size_t marker) const;
 
   public:
-    BcsSerializer() : Parent(BCS_MAX_CONTAINER_DEPTH) {}
+    using encoding = BcsEncoding;
+
+    BasicBcsSerializer(Sink sink = Sink())
+        : Parent(BCS_MAX_CONTAINER_DEPTH, std::move(sink)) {}
 
     void serialize_len(size_t value);
     void serialize_variant_index(uint32_t value);
 
-    static constexpr bool enforce_strict_map_ordering = true;
-    void sort_last_entries(std::vector<size_t> offsets);
+    void reset() {
+        Parent::reset();
+        entry_offsets_.clear();
+    }
+
+    // The number of bytes does not depend on the order of map entries.
+    static constexpr bool enforce_strict_map_ordering = !Sink::discards_output;
+
+    // Map entries are sorted by their encodings as follows: the marker
+    // returned by `begin_map_entries` is passed to `sort_last_entries` after
+    // calling `begin_map_entry` before each entry.
+    size_t begin_map_entries() { return entry_offsets_.size(); }
+    void begin_map_entry() { entry_offsets_.push_back(this->sink_.size()); }
+    void sort_last_entries(size_t marker);
+    // Same as `sort_last_entries` for entries that are known to be sorted
+    // already. This is only checked by assertions.
+    void check_last_entries(size_t marker);
+
+    // Run `f` on a serializer that buffers its output in memory, then write
+    // this output to the sink. This is how map entries are sorted when the
+    // sink does not support random access.
+    template <typename F>
+    void serialize_buffered(F f);
 };
 
+using BcsSerializer = BasicBcsSerializer<>;
+
 class BcsDeserializer : public BinaryDeserializer<BcsDeserializer> {
     using Parent = BinaryDeserializer<BcsDeserializer>;
 
     uint32_t deserialize_uleb128_as_u32();
 
   public:
+    using encoding = BcsEncoding;
+
+    // Decode a ULEB128 number one byte at a time. This is used near the end
+    // of the input, and as a baseline by benchmarks.
+    uint32_t deserialize_uleb128_as_u32_bytewise();
+
     BcsDeserializer(std::vector<uint8_t> bytes)
         : Parent(std::move(bytes), BCS_MAX_CONTAINER_DEPTH) {}
 
+    // Read borrowed bytes without copying them. The input must outlive the
+    // deserializer.
+    BcsDeserializer(const uint8_t *data, size_t size)
+        : Parent(InputBuffer(data, size), BCS_MAX_CONTAINER_DEPTH) {}
+
+#ifdef SERDE_HAS_SPAN
+    BcsDeserializer(std::span<const uint8_t> bytes)
+        : BcsDeserializer(bytes.data(), bytes.size()) {}
+#endif
+
     size_t deserialize_len();
     uint32_t deserialize_variant_index();
 
@@ -47,76 +124,197 @@ class BcsDeserializer : public BinaryDeserializer<BcsDeserializer> {
                                               std::tuple<size_t, size_t> key2);
 };
 
-inline void BcsSerializer::serialize_u32_as_uleb128(uint32_t value) {
-    while (value >= 0x80) {
-        bytes_.push_back((uint8_t)((value & 0x7F) | 0x80));
-        value = value >> 7;
+// Number of bytes of the ULEB128 encoding of `value`.
+constexpr size_t uleb128_length(uint32_t value) {
+    return 1 + (value >= (1u << 7)) + (value >= (1u << 14)) +
+           (value >= (1u << 21)) + (value >= (1u << 28));
+}
+
+template <class Sink>
+void BasicBcsSerializer<Sink>::serialize_u32_as_uleb128(uint32_t value) {
+    // Most lengths and variant indices fit in one byte.
+    if (value < 0x80) {
+        *this->sink_.extend(1) = (uint8_t)value;
+        return;
+    }
+    auto len = uleb128_length(value);
+    auto dst = this->sink_.extend(len);
+    for (size_t i = 0; i + 1 < len; i++) {
+        dst[i] = (uint8_t)(value | 0x80);
+        value >>= 7;
     }
-    bytes_.push_back((uint8_t)value);
+    dst[len - 1] = (uint8_t)value;
 }
 
-inline void BcsSerializer::serialize_len(size_t value) {
+template <class Sink>
+void BasicBcsSerializer<Sink>::serialize_len(size_t value) {
     if (value > BCS_MAX_LENGTH) {
-        throw serde::serialization_error("Length is too large");
+        SERDE_THROW(serialization_error("Length is too large"));
     }
     serialize_u32_as_uleb128((uint32_t)value);
 }
 
-inline void BcsSerializer::serialize_variant_index(uint32_t value) {
+template <class Sink>
+void BasicBcsSerializer<Sink>::serialize_variant_index(uint32_t value) {
     serialize_u32_as_uleb128(value);
 }
 
-inline void BcsSerializer::sort_last_entries(std::vector<size_t> offsets) {
-    if (offsets.size() <= 1) {
-        return;
-    }
-    offsets.push_back(bytes_.size());
+// Whether the byte slice `[data1, data1 + len1)` comes strictly before
+// `[data2, data2 + len2)` in lexicographic order.
+inline bool is_slice_less(const uint8_t *data1, size_t len1,
+                          const uint8_t *data2, size_t len2) {
+    auto len = std::min(len1, len2);
+    int order = len == 0 ? 0 : std::memcmp(data1, data2, len);
+    return order < 0 || (order == 0 && len1 < len2);
+}
 
-    std::vector<std::vector<uint8_t>> slices;
-    for (auto i = 1; i < offsets.size(); i++) {
-        auto start = bytes_.cbegin() + offsets[i - 1];
-        auto end = bytes_.cbegin() + offsets[i];
-        slices.emplace_back(start, end);
+template <class Sink>
+bool BasicBcsSerializer<Sink>::are_last_entries_increasing(
+    size_t marker) const {
+    const auto &sink = this->sink_;
+    auto data = sink.data();
+    auto offsets = entry_offsets_.data() + marker;
+    size_t count = entry_offsets_.size() - marker;
+    for (size_t i = 1; i < count; i++) {
+        auto end = i + 1 < count ? offsets[i + 1] : sink.size();
+        if (!is_slice_less(data + offsets[i - 1], offsets[i] - offsets[i - 1],
+                           data + offsets[i], end - offsets[i])) {
+            return false;
+        }
     }
+    return true;
+}
+
+template <class Sink>
+void BasicBcsSerializer<Sink>::check_last_entries(size_t marker) {
+    assert(are_last_entries_increasing(marker));
+    entry_offsets_.resize(marker);
+}
 
-    std::sort(slices.begin(), slices.end(), [](auto &s1, auto &s2) {
-        return std::lexicographical_compare(s1.begin(), s1.end(), s2.begin(),
-                                            s2.end());
-    });
+template <class Sink>
+void BasicBcsSerializer<Sink>::sort_last_entries(size_t marker) {
+    static_assert(Sink::is_random_access);
+    auto &sink = this->sink_;
+    auto data = sink.data();
+    auto offsets = entry_offsets_.data() + marker;
+    size_t count = entry_offsets_.size() - marker;
+    size_t first = count > 0 ? offsets[0] : sink.size();
+    auto entry_end = [&](size_t i) {
+        return i + 1 < count ? offsets[i + 1] : sink.size();
+    };
 
-    bytes_.resize(offsets[0]);
-    for (auto slice : slices) {
-        bytes_.insert(bytes_.end(), slice.begin(), slice.end());
+    // Fast path: entries are often serialized in the expected order already.
+    if (!are_last_entries_increasing(marker)) {
+        // Sort the entries, then copy them in order from a copy of the
+        // unsorted ones.
+        sort_entries_.clear();
+        for (size_t k = 0; k < count; k++) {
+            SortEntry entry = {0, offsets[k], entry_end(k) - offsets[k]};
+            for (size_t b = 0; b < 8 && b < entry.len; b++) {
+                entry.prefix |= (uint64_t)data[entry.start + b] << (56 - 8 * b);
+            }
+            sort_entries_.push_back(entry);
+        }
+        std::sort(sort_entries_.begin(), sort_entries_.end(),
+                  [data](const SortEntry &entry1, const SortEntry &entry2) {
+                      if (entry1.prefix != entry2.prefix) {
+                          return entry1.prefix < entry2.prefix;
+                      }
+                      return is_slice_less(data + entry1.start, entry1.len,
+                                           data + entry2.start, entry2.len);
+                  });
+        sort_scratch_.assign(data + first, data + sink.size());
+        auto dst = data + first;
+        for (const auto &entry : sort_entries_) {
+            std::memcpy(dst, sort_scratch_.data() + (entry.start - first),
+                        entry.len);
+            dst += entry.len;
+        }
+        assert(dst == data + sink.size());
     }
-    assert(offsets.back() == bytes_.size());
+    entry_offsets_.resize(marker);
+}
+
+template <class Sink>
+template <typename F>
+void BasicBcsSerializer<Sink>::serialize_buffered(F f) {
+    BasicBcsSerializer<VectorSink> buffered;
+    buffered.container_depth_budget_ = this->container_depth_budget_;
+    f(buffered);
+    const auto &output = buffered.sink();
+    this->sink_.append(output.data(), output.size());
 }
 
+// Decode the (at most 5) bytes of a ULEB128 number at once, with a single
+// bounds check. Near the end of the input, bytes are read one by one instead.
 inline uint32_t BcsDeserializer::deserialize_uleb128_as_u32() {
+    auto src = peek();
+    auto available = remaining();
+    // Most lengths and variant indices fit in one byte.
+    if (available > 0 && src[0] < 0x80) {
+        consume(1);
+        return src[0];
+    }
+    if (available < 5) {
+        return deserialize_uleb128_as_u32_bytewise();
+    }
+    uint64_t word =
+        load_little_endian<uint32_t>(src) | ((uint64_t)src[4] << 32);
+    // The high bit of the last byte of the number is 0. `mask` selects the
+    // bytes of the number.
+    uint64_t ends = ~word & 0x8080808080;
+    if (ends == 0) {
+        consume(5);
+        fail("Overflow while parsing uleb128-encoded uint32 value");
+        return 0;
+    }
+    uint64_t mask = ends ^ (ends - 1);
+    // Count the bytes of the number with a multiplication.
+    size_t len = (((mask & 0x0101010101) * 0x0101010101) >> 32) & 0xFF;
+    uint64_t digits = word & mask & 0x7F7F7F7F7F;
+    uint64_t value = (digits & 0x7F) | ((digits >> 1) & 0x3F80) |
+                     ((digits >> 2) & 0x1FC000) |
+                     ((digits >> 3) & 0xFE00000) |
+                     ((digits >> 4) & 0x7F0000000);
+    consume(len);
+    if (value > std::numeric_limits<uint32_t>::max()) {
+        fail("Overflow while parsing uleb128-encoded uint32 value");
+        return 0;
+    }
+    // Reject non-canonical encodings, i.e. a last digit equal to zero.
+    if ((value >> (7 * (len - 1))) == 0) {
+        fail("Invalid uleb128 number (unexpected zero digit)");
+        return 0;
+    }
+    return (uint32_t)value;
+}
+
+inline uint32_t BcsDeserializer::deserialize_uleb128_as_u32_bytewise() {
     uint64_t value = 0;
     for (int shift = 0; shift < 32; shift += 7) {
         auto byte = read_byte();
         auto digit = byte & 0x7F;
         value |= (uint64_t)digit << shift;
         if (value > std::numeric_limits<uint32_t>::max()) {
-            throw serde::deserialization_error(
-                "Overflow while parsing uleb128-encoded uint32 value");
+            break;
         }
         if (digit == byte) {
             if (shift > 0 && digit == 0) {
-                throw serde::deserialization_error(
-                    "Invalid uleb128 number (unexpected zero digit)");
+                fail("Invalid uleb128 number (unexpected zero digit)");
+                return 0;
             }
             return (uint32_t)value;
         }
     }
-    throw serde::deserialization_error(
-        "Overflow while parsing uleb128-encoded uint32 value");
+    fail("Overflow while parsing uleb128-encoded uint32 value");
+    return 0;
 }
 
 inline size_t BcsDeserializer::deserialize_len() {
     auto value = deserialize_uleb128_as_u32();
     if (value > BCS_MAX_LENGTH) {
-        throw serde::deserialization_error("Length is too large");
+        fail("Length is too large");
+        return 0;
     }
     return (size_t)value;
 }
@@ -127,14 +325,37 @@ inline uint32_t BcsDeserializer::deserialize_variant_index() {
 
 inline void BcsDeserializer::check_that_key_slices_are_increasing(
     std::tuple<size_t, size_t> key1, std::tuple<size_t, size_t> key2) {
-    if (!std::lexicographical_compare(bytes_.cbegin() + std::get<0>(key1),
-                                      bytes_.cbegin() + std::get<1>(key1),
-                                      bytes_.cbegin() + std::get<0>(key2),
-                                      bytes_.cbegin() + std::get<1>(key2))) {
-        throw serde::deserialization_error(
-            "Error while decoding map: keys are not serialized in the "
-            "expected order");
+    // Compare the two byte slices lexicographically.
+    auto len1 = std::get<1>(key1) - std::get<0>(key1);
+    auto len2 = std::get<1>(key2) - std::get<0>(key2);
+    auto len = std::min(len1, len2);
+    int order = len == 0 ? 0
+                         : std::memcmp(bytes_.data() + std::get<0>(key1),
+                                       bytes_.data() + std::get<0>(key2), len);
+    if (order > 0 || (order == 0 && len1 >= len2)) {
+        fail("Error while decoding map: keys are not serialized in the "
+             "expected order");
+    }
+}
+
+// Types without a specialization of `EncodedComparison` (e.g. external
+// definitions) are compared by serializing them.
+template <typename T>
+int EncodedComparison<T>::compare(const T &lhs, const T &rhs) {
+    BcsSerializer lhs_serializer;
+    Serializable<T>::serialize(lhs, lhs_serializer);
+    BcsSerializer rhs_serializer;
+    Serializable<T>::serialize(rhs, rhs_serializer);
+    auto lhs_bytes = std::move(lhs_serializer).bytes();
+    auto rhs_bytes = std::move(rhs_serializer).bytes();
+    auto len = std::min(lhs_bytes.size(), rhs_bytes.size());
+    int order =
+        len == 0 ? 0 : std::memcmp(lhs_bytes.data(), rhs_bytes.data(), len);
+    if (order != 0) {
+        return order;
     }
+    return (lhs_bytes.size() > rhs_bytes.size()) -
+           (lhs_bytes.size() < rhs_bytes.size());
 }
 
 } // end of namespace serde
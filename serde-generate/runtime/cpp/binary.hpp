@@ -5,23 +5,424 @@
 
 #include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <type_traits>
 #include <variant>
+#include <vector>
+
+#if __cplusplus >= 202002L && __has_include(<span>)
+#include <span>
+#define SERDE_HAS_SPAN 1
+#endif
+
+#if __has_include(<unistd.h>)
+#include <cerrno>
+#include <unistd.h>
+#endif
+
+// SIMD instructions used to skip ASCII text, when enabled at compile time.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SERDE_HAS_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SERDE_HAS_SSE2 1
+#endif
 
 #include "serde.hpp"
 
 namespace serde {
 
-template <class S>
+// Whether the host stores integers in little-endian order, i.e. the byte order
+// of the binary formats. Other hosts fall back to portable shifts.
+#if defined(__BYTE_ORDER__) && defined(__ORDER_LITTLE_ENDIAN__)
+constexpr bool host_is_little_endian =
+    __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__;
+#elif defined(_MSC_VER)
+constexpr bool host_is_little_endian = true;
+#else
+constexpr bool host_is_little_endian = false;
+#endif
+
+// Write the unsigned integer `value` in little-endian order at `dst`.
+template <typename T>
+inline void store_little_endian(uint8_t *dst, T value) {
+    static_assert(std::is_unsigned<T>::value);
+    if constexpr (host_is_little_endian) {
+        std::memcpy(dst, &value, sizeof(T));
+    } else {
+        for (size_t i = 0; i < sizeof(T); i++) {
+            dst[i] = (uint8_t)(value >> (8 * i));
+        }
+    }
+}
+
+// Read an unsigned integer stored in little-endian order at `src`.
+template <typename T>
+inline T load_little_endian(const uint8_t *src) {
+    static_assert(std::is_unsigned<T>::value);
+    T value;
+    if constexpr (host_is_little_endian) {
+        std::memcpy(&value, src, sizeof(T));
+    } else {
+        value = 0;
+        for (size_t i = 0; i < sizeof(T); i++) {
+            value |= (T)src[i] << (8 * i);
+        }
+    }
+    return value;
+}
+
+// Fixed-width integers are encoded as their little-endian representation.
+template <typename T>
+constexpr bool is_fixed_width_integer =
+    std::is_same<T, uint8_t>::value || std::is_same<T, uint16_t>::value ||
+    std::is_same<T, uint32_t>::value || std::is_same<T, uint64_t>::value ||
+    std::is_same<T, int8_t>::value || std::is_same<T, int16_t>::value ||
+    std::is_same<T, int32_t>::value || std::is_same<T, int64_t>::value;
+
+// Unsigned integer type of the same size as `T`.
+template <typename T>
+using bits_type = typename std::conditional<
+    sizeof(T) == 1, uint8_t,
+    typename std::conditional<
+        sizeof(T) == 2, uint16_t,
+        typename std::conditional<sizeof(T) == 4, uint32_t,
+                                  uint64_t>::type>::type>::type;
+
+// Read `n` values of type `T` (integers, floats, or booleans) stored in a row
+// in little-endian order at `src`.
+template <typename T>
+inline void load_array_little_endian(T *dst, const uint8_t *src, size_t n) {
+    static_assert(sizeof(T) == sizeof(bits_type<T>));
+    if constexpr (host_is_little_endian || sizeof(T) == 1) {
+        if (n > 0) {
+            std::memcpy(dst, src, n * sizeof(T));
+        }
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            auto bits = load_little_endian<bits_type<T>>(src + i * sizeof(T));
+            std::memcpy(dst + i, &bits, sizeof(T));
+        }
+    }
+}
+
+// Whether `n` bytes are all valid encodings of booleans, i.e. 0 or 1. The
+// loop has no branches so that compilers can vectorize it.
+inline bool are_valid_bools(const uint8_t *src, size_t n) {
+    uint8_t bits = 0;
+    for (size_t i = 0; i < n; i++) {
+        bits |= src[i];
+    }
+    return bits <= 1;
+}
+
+// --- Output sinks ---
+//
+// A sink is the output target of a serializer. Sinks provide:
+// * `uint8_t *extend(size_t n)`: reserve `n <= max_extend` bytes, advance the
+//   cursor and return a pointer where the caller writes exactly `n` bytes,
+// * `void append(const uint8_t *data, size_t n)` for arbitrary sizes,
+// * `size_t size() const`: the number of bytes written so far.
+// Sinks with `is_random_access` also provide `data()` and `truncate(size)` so
+// that written bytes can be re-ordered (e.g. BCS map entries). Sinks with
+// `discards_output` do not keep the bytes at all.
+
+// Growable buffer with a write cursor. This is the default sink.
+// Storage is grown geometrically and ahead of the cursor, so that writing a
+// primitive or a string costs a single capacity check followed by plain
+// stores.
+class VectorSink {
+    std::vector<uint8_t> storage_;
+    size_t size_ = 0;
+
+    void grow(size_t additional);
+
+  public:
+    static constexpr bool is_random_access = true;
+    static constexpr bool discards_output = false;
+    static constexpr size_t max_extend = SIZE_MAX;
+
+    VectorSink() = default;
+
+    // Append to the content of `bytes`, re-using its capacity.
+    explicit VectorSink(std::vector<uint8_t> bytes)
+        : storage_(std::move(bytes)), size_(storage_.size()) {}
+
+    uint8_t *extend(size_t n) {
+        if (storage_.size() - size_ < n) {
+            grow(n);
+        }
+        uint8_t *dst = storage_.data() + size_;
+        size_ += n;
+        return dst;
+    }
+
+    void append(const uint8_t *data, size_t n) {
+        if (n > 0) {
+            std::memcpy(extend(n), data, n);
+        }
+    }
+
+    // Move the cursor back to `size`, which must not exceed `size()`.
+    void truncate(size_t size) {
+        assert(size <= size_);
+        size_ = size;
+    }
+
+    // Discard the content but keep the allocated storage.
+    void reset() { size_ = 0; }
+
+    // Make room for `additional` bytes so that writing them does not
+    // re-allocate.
+    void reserve(size_t additional) {
+        if (storage_.size() - size_ < additional) {
+            storage_.resize(size_ + additional);
+        }
+    }
+
+    uint8_t *data() { return storage_.data(); }
+    const uint8_t *data() const { return storage_.data(); }
+    size_t size() const { return size_; }
+
+    std::vector<uint8_t> bytes() && {
+        storage_.resize(size_);
+        size_ = 0;
+        return std::move(storage_);
+    }
+};
+
+inline void VectorSink::grow(size_t additional) {
+    size_t capacity = std::max<size_t>(2 * storage_.size(), 64);
+    storage_.resize(std::max(capacity, size_ + additional));
+}
+
+// Caller-provided buffer of fixed capacity. Writing past the end throws
+// `serialization_error`; the buffer must outlive the sink.
+class FixedBufferSink {
+    uint8_t *data_;
+    size_t capacity_;
+    size_t size_ = 0;
+
+  public:
+    static constexpr bool is_random_access = true;
+    static constexpr bool discards_output = false;
+    static constexpr size_t max_extend = SIZE_MAX;
+
+    FixedBufferSink(uint8_t *data, size_t capacity)
+        : data_(data), capacity_(capacity) {}
+
+    uint8_t *extend(size_t n) {
+        if (capacity_ - size_ < n) {
+            SERDE_THROW(serialization_error("Output buffer is too small"));
+        }
+        uint8_t *dst = data_ + size_;
+        size_ += n;
+        return dst;
+    }
+
+    void append(const uint8_t *data, size_t n) {
+        if (n > 0) {
+            std::memcpy(extend(n), data, n);
+        }
+    }
+
+    void truncate(size_t size) {
+        assert(size <= size_);
+        size_ = size;
+    }
+
+    void reset() { size_ = 0; }
+
+    uint8_t *data() { return data_; }
+    const uint8_t *data() const { return data_; }
+    size_t size() const { return size_; }
+};
+
+// Count the bytes that would be written, without storing them.
+class CountingSink {
+    // Scratch space for `extend`. Its content is never read.
+    uint8_t scratch_[16];
+    size_t size_ = 0;
+
+  public:
+    static constexpr bool is_random_access = false;
+    static constexpr bool discards_output = true;
+    static constexpr size_t max_extend = sizeof(scratch_);
+
+    uint8_t *extend(size_t n) {
+        assert(n <= max_extend);
+        size_ += n;
+        return scratch_;
+    }
+
+    void append(const uint8_t *, size_t n) { size_ += n; }
+
+    void reset() { size_ = 0; }
+
+    size_t size() const { return size_; }
+};
+
+#if __has_include(<unistd.h>)
+// Buffered writer to a file descriptor (e.g. a file or a socket). Bytes are
+// written when the internal buffer is full, when `flush()` is called, and on
+// destruction (where errors are ignored). Write errors throw
+// `serialization_error`, after which nothing is written anymore.
+class FileDescriptorSink {
+    int fd_;
+    std::vector<uint8_t> buffer_;
+    size_t buffered_ = 0;
+    size_t flushed_ = 0;
+    // Set after a write error. Later writes would leave a gap in the output.
+    bool failed_ = false;
+
+    // Returns the number of bytes written, which is less than `n` on error.
+    size_t write_all(const uint8_t *data, size_t n);
+    void fail();
+
+  public:
+    static constexpr bool is_random_access = false;
+    static constexpr bool discards_output = false;
+    static constexpr size_t max_extend = 16;
+
+    explicit FileDescriptorSink(int fd, size_t buffer_size = 1 << 16)
+        : fd_(fd), buffer_(std::max<size_t>(buffer_size, max_extend)) {}
+
+    FileDescriptorSink(const FileDescriptorSink &) = delete;
+    FileDescriptorSink &operator=(const FileDescriptorSink &) = delete;
+
+    FileDescriptorSink(FileDescriptorSink &&other)
+        : fd_(other.fd_), buffer_(std::move(other.buffer_)),
+          buffered_(other.buffered_), flushed_(other.flushed_),
+          failed_(other.failed_) {
+        other.buffered_ = 0;
+    }
+
+    ~FileDescriptorSink() {
+        if (!failed_) {
+            write_all(buffer_.data(), buffered_);
+        }
+    }
+
+    uint8_t *extend(size_t n) {
+        assert(n <= max_extend);
+        if (buffer_.size() - buffered_ < n) {
+            flush();
+        }
+        uint8_t *dst = buffer_.data() + buffered_;
+        buffered_ += n;
+        return dst;
+    }
+
+    void append(const uint8_t *data, size_t n) {
+        if (buffer_.size() - buffered_ < n) {
+            flush();
+            if (n >= buffer_.size()) {
+                if (write_all(data, n) < n) {
+                    fail();
+                }
+                return;
+            }
+        }
+        std::memcpy(buffer_.data() + buffered_, data, n);
+        buffered_ += n;
+    }
+
+    void flush() {
+        if (failed_) {
+            fail();
+        }
+        size_t written = write_all(buffer_.data(), buffered_);
+        if (written < buffered_) {
+            // Drop the bytes that were written so that they are never
+            // written twice.
+            std::memmove(buffer_.data(), buffer_.data() + written,
+                         buffered_ - written);
+            buffered_ -= written;
+            fail();
+        }
+        buffered_ = 0;
+    }
+
+    size_t size() const { return flushed_ + buffered_; }
+};
+
+inline size_t FileDescriptorSink::write_all(const uint8_t *data, size_t n) {
+    size_t total = 0;
+    while (total < n) {
+        auto written = ::write(fd_, data + total, n - total);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        total += written;
+        flushed_ += written;
+    }
+    return total;
+}
+
+inline void FileDescriptorSink::fail() {
+    failed_ = true;
+    SERDE_THROW(serialization_error("Failed to write to file descriptor"));
+}
+#endif
+
+// Input of a deserializer. The bytes are either owned by the buffer or
+// borrowed from the caller, in which case they must outlive the buffer.
+class InputBuffer {
+    std::vector<uint8_t> owned_;
+    const uint8_t *data_;
+    size_t size_;
+
+  public:
+    InputBuffer(std::vector<uint8_t> bytes)
+        : owned_(std::move(bytes)), data_(owned_.data()),
+          size_(owned_.size()) {}
+
+    InputBuffer(const uint8_t *data, size_t size) : data_(data), size_(size) {}
+
+    InputBuffer(const InputBuffer &other)
+        : owned_(other.owned_), data_(other.data_), size_(other.size_) {
+        if (other.data_ == other.owned_.data()) {
+            data_ = owned_.data();
+        }
+    }
+
+    InputBuffer &operator=(const InputBuffer &other) {
+        InputBuffer temp{other};
+        *this = std::move(temp);
+        return *this;
+    }
+
+    // Moving a vector preserves its heap storage, hence `data_`.
+    InputBuffer(InputBuffer &&other) = default;
+
+    InputBuffer &operator=(InputBuffer &&other) = default;
+
+    const uint8_t *data() const { return data_; }
+    size_t size() const { return size_; }
+    const uint8_t *begin() const { return data_; }
+    const uint8_t *end() const { return data_ + size_; }
+};
+
+template <class S, class Sink = VectorSink>
 class BinarySerializer {
   protected:
-    std::vector<uint8_t> bytes_;
+    Sink sink_;
+    size_t max_container_depth_;
     size_t container_depth_budget_;
 
   public:
-    BinarySerializer(size_t max_container_depth)
-        : container_depth_budget_(max_container_depth) {}
+    using sink_type = Sink;
+
+    BinarySerializer(size_t max_container_depth, Sink sink = Sink())
+        : sink_(std::move(sink)), max_container_depth_(max_container_depth),
+          container_depth_budget_(max_container_depth) {}
 
-    void serialize_str(const std::string &value);
+    void serialize_str(std::string_view value);
 
     void serialize_bool(bool value);
     void serialize_unit();
@@ -40,30 +441,133 @@ class BinarySerializer {
     void serialize_i32(int32_t value);
     void serialize_i64(int64_t value);
     void serialize_i128(const int128_t &value);
+#ifdef SERDE_HAS_INT128
+    void serialize_u128(native_uint128_t value);
+    void serialize_i128(native_int128_t value);
+#endif
     void serialize_option_tag(bool value);
 
+    // Whether sequences of `T` can be written with `serialize_array`.
+    template <typename T>
+    static constexpr bool supports_bulk_array =
+        is_fixed_width_integer<T> || std::is_same<T, bool>::value;
+
+    // Write `n` values of type `T` in a row.
+    template <typename T>
+    void serialize_array(const T *values, size_t n);
+
     size_t get_buffer_offset();
     void increase_container_depth();
     void decrease_container_depth();
 
-    std::vector<uint8_t> bytes() && { return std::move(bytes_); }
+    // Encodings without a depth limit override this to `false`, which turns
+    // depth tracking into a no-op.
+    static constexpr bool limits_container_depth = true;
+
+    // Whether `depth` more levels of nested containers fit in the remaining
+    // budget.
+    bool has_container_depth_budget(size_t depth) const {
+        return !S::limits_container_depth || container_depth_budget_ >= depth;
+    }
+
+    // Fail unless `depth` more levels of nested containers fit in the
+    // remaining budget. Generated code calls this once for the outermost
+    // non-recursive types, whose maximum depth is known statically, instead
+    // of tracking the depth of each nested container.
+    void check_container_depth_budget(size_t depth);
+
+    // Discard the output so far (keeping allocated memory if the sink
+    // supports it) and restore the container depth budget. This makes it
+    // possible to re-use a serializer, including after an error.
+    void reset() {
+        sink_.reset();
+        container_depth_budget_ = max_container_depth_;
+    }
+
+    Sink &sink() { return sink_; }
+
+    // Only available with VectorSink.
+    std::vector<uint8_t> bytes() && { return std::move(sink_).bytes(); }
 };
 
+// Compute the size of the encoding of `value` without storing it. The
+// `Serializer` is expected to write to a `CountingSink`.
+template <typename Serializer, typename T>
+size_t serialized_size(const T &value) {
+    static_assert(Serializer::sink_type::discards_output,
+                  "serialized_size requires a counting serializer");
+    constexpr auto bounds =
+        encoded_size_bounds<T, typename Serializer::encoding>;
+    if constexpr (bounds.is_fixed()) {
+        return bounds.min;
+    } else {
+        Serializer serializer;
+        Serializable<T>::serialize(value, serializer);
+        return serializer.sink().size();
+    }
+}
+
+// Append the encoding of `value` to `output`, re-using its capacity. On
+// error, `output` is restored to its original content.
+template <typename Serializer, typename T>
+void serialize_into(const T &value, std::vector<uint8_t> &output) {
+#ifdef SERDE_HAS_EXCEPTIONS
+    size_t size = output.size();
+    Serializer serializer(VectorSink(std::move(output)));
+    try {
+        Serializable<T>::serialize(value, serializer);
+    } catch (...) {
+        output = std::move(serializer).bytes();
+        output.resize(size);
+        throw;
+    }
+#else
+    Serializer serializer(VectorSink(std::move(output)));
+    Serializable<T>::serialize(value, serializer);
+#endif
+    output = std::move(serializer).bytes();
+}
+
 template <class D>
 class BinaryDeserializer {
     size_t pos_;
     size_t container_depth_budget_;
+    // Containers entered after the depth budget was exhausted (when errors
+    // are recorded). Leaving them must not restore the budget.
+    size_t exhausted_container_depth_ = 0;
+    size_t allocation_budget_ = SIZE_MAX;
+#ifdef SERDE_HAS_PMR
+    std::pmr::memory_resource *memory_resource_ = nullptr;
+#endif
+    bool records_errors_ = false;
+    deserialization_failure failure_ = {nullptr, 0};
 
   protected:
-    std::vector<uint8_t> bytes_;
+    InputBuffer bytes_;
+    // After an error, these functions return 0 and `nullptr` respectively
+    // (when errors are recorded).
     uint8_t read_byte();
+    const uint8_t *read_bytes(size_t len);
+    template <typename T>
+    T read_little_endian();
+    template <typename T>
+    const uint8_t *read_array(size_t n);
+    // Unchecked access to the rest of the input, for decoders that check
+    // bounds themselves. `consume(len)` requires `len <= remaining()`.
+    const uint8_t *peek() const { return bytes_.data() + pos_; }
+    size_t remaining() const { return bytes_.size() - pos_; }
+    void consume(size_t len) { pos_ += len; }
 
   public:
-    BinaryDeserializer(std::vector<uint8_t> bytes, size_t max_container_depth)
+    BinaryDeserializer(InputBuffer bytes, size_t max_container_depth)
         : pos_(0), container_depth_budget_(max_container_depth),
           bytes_(std::move(bytes)) {}
 
     std::string deserialize_str();
+    // Same as `deserialize_str`, reusing the capacity of `value`.
+    template <typename Allocator>
+    void deserialize_str_into(
+        std::basic_string<char, std::char_traits<char>, Allocator> &value);
 
     bool deserialize_bool();
     std::monostate deserialize_unit();
@@ -82,181 +586,435 @@ class BinaryDeserializer {
     int32_t deserialize_i32();
     int64_t deserialize_i64();
     int128_t deserialize_i128();
+#ifdef SERDE_HAS_INT128
+    native_uint128_t deserialize_native_u128();
+    native_int128_t deserialize_native_i128();
+#endif
 
     bool deserialize_option_tag();
 
+    // Whether sequences of `T` can be read with `deserialize_array` and
+    // `deserialize_vector`.
+    template <typename T>
+    static constexpr bool supports_bulk_array =
+        is_fixed_width_integer<T> || std::is_same<T, bool>::value;
+
+    // Read `n` values of type `T` in a row.
+    template <typename T>
+    void deserialize_array(T *dst, size_t n);
+
+    // Same as `deserialize_array` for a new vector. The size of the input is
+    // checked before allocating.
+    template <typename T>
+    std::vector<T> deserialize_vector(size_t n);
+    template <typename T, typename Allocator>
+    void deserialize_vector_into(std::vector<T, Allocator> &value, size_t n);
+
+    // Check that `n` values of at least `min_size > 0` bytes each may fit in
+    // the rest of the input. This rejects forged lengths before allocating
+    // memory for them.
+    bool check_remaining_input(size_t n, size_t min_size);
+
+    // Limit the memory allocated for deserialized values to about `bytes`
+    // in total. Strings, vectors, map nodes and `value_ptr` are charged
+    // before being allocated. Exceeding the budget is reported with
+    // `allocation_budget_exceeded`. There is no limit by default.
+    void set_allocation_budget(size_t bytes) { allocation_budget_ = bytes; }
+    size_t allocation_budget() const { return allocation_budget_; }
+    // Charge `n` allocations of `size > 0` bytes each.
+    bool charge_allocation(size_t n, size_t size);
+
+#ifdef SERDE_HAS_PMR
+    // Memory resource of the `std::pmr` containers (and `serde::pmr`
+    // pointers) created by the deserializer, e.g. a monotonic arena released
+    // at once after a batch of values. Defaults to
+    // `std::pmr::get_default_resource()`.
+    void set_memory_resource(std::pmr::memory_resource *resource) {
+        memory_resource_ = resource;
+    }
+    std::pmr::memory_resource *memory_resource() const {
+        return memory_resource_ != nullptr ? memory_resource_
+                                           : std::pmr::get_default_resource();
+    }
+#endif
+
     size_t get_buffer_offset();
     void increase_container_depth();
     void decrease_container_depth();
+
+    // See `BinarySerializer`.
+    static constexpr bool limits_container_depth = true;
+    bool has_container_depth_budget(size_t depth) const {
+        return !D::limits_container_depth || container_depth_budget_ >= depth;
+    }
+    void check_container_depth_budget(size_t depth);
+
+    // Errors are thrown as `deserialization_error` by default. Once
+    // `record_errors()` is called, the first error is recorded instead, the
+    // rest of the input is skipped, and deserialized values are unspecified
+    // (e.g. with zeros and empty containers). This avoids the cost of
+    // exceptions on invalid inputs.
+    void record_errors() { records_errors_ = true; }
+    void fail(const char *message);
+    bool has_failed() const { return failure_.message != nullptr; }
+
+    // Wrap a deserialized value or the recorded error.
+    template <typename T>
+    deserialization_result<T> make_result(T value) const {
+        if (has_failed()) {
+            return failure_;
+        }
+        return value;
+    }
 };
 
-template <class S>
-void BinarySerializer<S>::serialize_str(const std::string &value) {
+// Deserialize a value without throwing exceptions on invalid inputs.
+template <typename T, typename Deserializer>
+deserialization_result<T> try_deserialize(Deserializer &deserializer) {
+    deserializer.record_errors();
+    auto value = Deserializable<T>::deserialize(deserializer);
+    return deserializer.make_result(std::move(value));
+}
+
+template <class S, class Sink>
+void BinarySerializer<S, Sink>::serialize_str(std::string_view value) {
     static_cast<S *>(this)->serialize_len(value.size());
-    for (auto c : value) {
-        bytes_.push_back(c);
-    }
+    sink_.append(reinterpret_cast<const uint8_t *>(value.data()),
+                 value.size());
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_unit() {}
+template <class S, class Sink>
+void BinarySerializer<S, Sink>::serialize_unit() {}
 
-template <class S>
-void BinarySerializer<S>::serialize_f32(float) {
-    throw serde::serialization_error("not implemented");
+template <class S, class Sink>
+void BinarySerializer<S, Sink>::serialize_f32(float) {
+    SERDE_THROW(serialization_error("not implemented"));
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_f64(double) {
-    throw serde::serialization_error("not implemented");
+template <class S, class Sink>
+void BinarySerializer<S, Sink>::serialize_f64(double) {
+    SERDE_THROW(serialization_error("not implemented"));
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_char(char32_t) {
-    throw serde::serialization_error("not implemented");
+template <class S, class Sink>
+void BinarySerializer<S, Sink>::serialize_char(char32_t) {
+    SERDE_THROW(serialization_error("not implemented"));
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_bool(bool value) {
-    bytes_.push_back((uint8_t)value);
+template <class S, class Sink>
+void BinarySerializer<S, Sink>::serialize_bool(bool value) {
+    *sink_.extend(1) = (uint8_t)value;
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_u8(uint8_t value) {
-    bytes_.push_back(value);
+template <class S, class Sink>
+void BinarySerializer<S, Sink>::serialize_u8(uint8_t value) {
+    *sink_.extend(1) = value;
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_u16(uint16_t value) {
-    bytes_.push_back((uint8_t)value);
-    bytes_.push_back((uint8_t)(value >> 8));
+template <class S, class Sink>
+void BinarySerializer<S, Sink>::serialize_u16(uint16_t value) {
+    store_little_endian(sink_.extend(sizeof(value)), value);
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_u32(uint32_t value) {
-    bytes_.push_back((uint8_t)value);
-    bytes_.push_back((uint8_t)(value >> 8));
-    bytes_.push_back((uint8_t)(value >> 16));
-    bytes_.push_back((uint8_t)(value >> 24));
+template <class S, class Sink>
+void BinarySerializer<S, Sink>::serialize_u32(uint32_t value) {
+    store_little_endian(sink_.extend(sizeof(value)), value);
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_u64(uint64_t value) {
-    bytes_.push_back((uint8_t)value);
-    bytes_.push_back((uint8_t)(value >> 8));
-    bytes_.push_back((uint8_t)(value >> 16));
-    bytes_.push_back((uint8_t)(value >> 24));
-    bytes_.push_back((uint8_t)(value >> 32));
-    bytes_.push_back((uint8_t)(value >> 40));
-    bytes_.push_back((uint8_t)(value >> 48));
-    bytes_.push_back((uint8_t)(value >> 56));
+template <class S, class Sink>
+void BinarySerializer<S, Sink>::serialize_u64(uint64_t value) {
+    store_little_endian(sink_.extend(sizeof(value)), value);
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_u128(const uint128_t &value) {
-    serialize_u64(value.low);
-    serialize_u64(value.high);
+template <class S, class Sink>
+void BinarySerializer<S, Sink>::serialize_u128(const uint128_t &value) {
+    auto dst = sink_.extend(16);
+    store_little_endian(dst, value.low);
+    store_little_endian(dst + 8, value.high);
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_i8(int8_t value) {
+template <class S, class Sink>
+void BinarySerializer<S, Sink>::serialize_i8(int8_t value) {
     serialize_u8((uint8_t)value);
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_i16(int16_t value) {
+template <class S, class Sink>
+void BinarySerializer<S, Sink>::serialize_i16(int16_t value) {
     serialize_u16((uint16_t)value);
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_i32(int32_t value) {
+template <class S, class Sink>
+void BinarySerializer<S, Sink>::serialize_i32(int32_t value) {
     serialize_u32((uint32_t)value);
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_i64(int64_t value) {
+template <class S, class Sink>
+void BinarySerializer<S, Sink>::serialize_i64(int64_t value) {
     serialize_u64((uint64_t)value);
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_i128(const int128_t &value) {
-    serialize_u64(value.low);
-    serialize_i64(value.high);
+template <class S, class Sink>
+void BinarySerializer<S, Sink>::serialize_i128(const int128_t &value) {
+    auto dst = sink_.extend(16);
+    store_little_endian(dst, value.low);
+    store_little_endian(dst + 8, (uint64_t)value.high);
 }
 
-template <class S>
-void BinarySerializer<S>::serialize_option_tag(bool value) {
+#ifdef SERDE_HAS_INT128
+// Native integers are written with a single 16-byte store on little-endian
+// hosts.
+template <class S, class Sink>
+void BinarySerializer<S, Sink>::serialize_u128(native_uint128_t value) {
+    auto dst = sink_.extend(16);
+    if constexpr (host_is_little_endian) {
+        std::memcpy(dst, &value, 16);
+    } else {
+        store_little_endian(dst, (uint64_t)value);
+        store_little_endian(dst + 8, (uint64_t)(value >> 64));
+    }
+}
+
+template <class S, class Sink>
+void BinarySerializer<S, Sink>::serialize_i128(native_int128_t value) {
+    serialize_u128((native_uint128_t)value);
+}
+#endif
+
+template <class S, class Sink>
+void BinarySerializer<S, Sink>::serialize_option_tag(bool value) {
     serialize_bool(value);
 }
 
-template <class S>
-size_t BinarySerializer<S>::get_buffer_offset() {
-    return bytes_.size();
+template <class S, class Sink>
+template <typename T>
+void BinarySerializer<S, Sink>::serialize_array(const T *values, size_t n) {
+    static_assert(S::template supports_bulk_array<T>);
+    static_assert(sizeof(T) == sizeof(bits_type<T>));
+    if constexpr (host_is_little_endian || sizeof(T) == 1) {
+        sink_.append(reinterpret_cast<const uint8_t *>(values), n * sizeof(T));
+    } else {
+        for (size_t i = 0; i < n; i++) {
+            bits_type<T> bits;
+            std::memcpy(&bits, values + i, sizeof(T));
+            store_little_endian(sink_.extend(sizeof(T)), bits);
+        }
+    }
 }
 
-template <class S>
-void BinarySerializer<S>::increase_container_depth() {
+template <class S, class Sink>
+size_t BinarySerializer<S, Sink>::get_buffer_offset() {
+    return sink_.size();
+}
+
+template <class S, class Sink>
+void BinarySerializer<S, Sink>::increase_container_depth() {
+    if constexpr (!S::limits_container_depth) {
+        return;
+    }
     if (container_depth_budget_ == 0) {
-        throw serialization_error("Too many nested containers");
+        SERDE_THROW(serialization_error("Too many nested containers"));
     }
     container_depth_budget_--;
 }
 
-template <class S>
-void BinarySerializer<S>::decrease_container_depth() {
-    container_depth_budget_++;
+template <class S, class Sink>
+void BinarySerializer<S, Sink>::decrease_container_depth() {
+    if constexpr (S::limits_container_depth) {
+        container_depth_budget_++;
+    }
+}
+
+template <class S, class Sink>
+void BinarySerializer<S, Sink>::check_container_depth_budget(size_t depth) {
+    if (!has_container_depth_budget(depth)) {
+        SERDE_THROW(serialization_error("Too many nested containers"));
+    }
+}
+
+template <class D>
+void BinaryDeserializer<D>::fail(const char *message) {
+    if (!records_errors_) {
+        SERDE_THROW(deserialization_error(message));
+    }
+    if (!has_failed()) {
+        failure_ = {message, pos_};
+        pos_ = bytes_.size();
+    }
+}
+
+template <class D>
+bool BinaryDeserializer<D>::charge_allocation(size_t n, size_t size) {
+    if (n > allocation_budget_ / size) {
+        if (!records_errors_) {
+            SERDE_THROW(allocation_budget_exceeded());
+        }
+        fail(allocation_budget_exceeded::message);
+        return false;
+    }
+    allocation_budget_ -= n * size;
+    return true;
 }
 
 template <class D>
 uint8_t BinaryDeserializer<D>::read_byte() {
     if (pos_ >= bytes_.size()) {
-        throw serde::deserialization_error("Input is not large enough");
+        fail("Input is not large enough");
+        return 0;
     }
-    return bytes_.at(pos_++);
+    return bytes_.data()[pos_++];
 }
 
-inline bool is_valid_utf8(const std::string &input) {
-    uint8_t trailing_digits = 0;
-    for (uint8_t byte : input) {
-        if (trailing_digits == 0) {
-            // Start new codepoint.
-            if (byte >> 7 == 0) {
-                // ASCII character
-            } else if (byte >> 5 == 0b110) {
-                // Expecting a 2-byte codepoint
-                trailing_digits = 1;
-            } else if (byte >> 4 == 0b1110) {
-                // Expecting a 3-byte codepoint
-                trailing_digits = 2;
-            } else if (byte >> 3 == 0b11110) {
-                // Expecting a 4-byte codepoint
-                trailing_digits = 3;
-            } else {
-                return false;
+// Check once that `len` bytes remain, then consume them.
+template <class D>
+const uint8_t *BinaryDeserializer<D>::read_bytes(size_t len) {
+    if (len > bytes_.size() - pos_) {
+        fail("Input is not large enough");
+        return nullptr;
+    }
+    const uint8_t *src = bytes_.data() + pos_;
+    pos_ += len;
+    return src;
+}
+
+template <class D>
+template <typename T>
+T BinaryDeserializer<D>::read_little_endian() {
+    auto src = read_bytes(sizeof(T));
+    return src == nullptr ? 0 : load_little_endian<T>(src);
+}
+
+// Check once that `n` values of type `T` remain, then consume them. Booleans
+// are validated in bulk.
+template <class D>
+template <typename T>
+const uint8_t *BinaryDeserializer<D>::read_array(size_t n) {
+    static_assert(D::template supports_bulk_array<T>);
+    if (n > (bytes_.size() - pos_) / sizeof(T)) {
+        fail("Input is not large enough");
+        return nullptr;
+    }
+    const uint8_t *src = bytes_.data() + pos_;
+    if constexpr (std::is_same<T, bool>::value) {
+        if (!are_valid_bools(src, n)) {
+            fail("Invalid boolean value");
+            return nullptr;
+        }
+    }
+    pos_ += n * sizeof(T);
+    return src;
+}
+
+// Length of the longest prefix of `data` made of ASCII characters.
+inline size_t ascii_prefix_length(const uint8_t *data, size_t size) {
+    size_t i = 0;
+#ifdef SERDE_HAS_AVX2
+    for (; i + 32 <= size; i += 32) {
+        auto chunk = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i *>(data + i));
+        if (_mm256_movemask_epi8(chunk) != 0) {
+            break;
+        }
+    }
+#endif
+#ifdef SERDE_HAS_SSE2
+    for (; i + 16 <= size; i += 16) {
+        auto chunk =
+            _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+        if (_mm_movemask_epi8(chunk) != 0) {
+            break;
+        }
+    }
+#endif
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        if ((word & 0x8080808080808080ull) != 0) {
+            break;
+        }
+    }
+    while (i < size && data[i] < 0x80) {
+        i++;
+    }
+    return i;
+}
+
+// Check that `data` is well-formed UTF-8 (RFC 3629). Overlong encodings,
+// surrogates and code points above U+10FFFF are rejected. Runs of ASCII
+// characters are skipped in bulk.
+inline bool is_valid_utf8(const uint8_t *data, size_t size) {
+    size_t i = 0;
+    while (true) {
+        i += ascii_prefix_length(data + i, size - i);
+        if (i == size) {
+            return true;
+        }
+        // Decode a multi-byte codepoint. The range of the second byte
+        // excludes the invalid codepoints mentioned above.
+        uint8_t byte = data[i];
+        size_t len;
+        uint8_t low = 0x80;
+        uint8_t high = 0xbf;
+        if (byte >= 0xc2 && byte <= 0xdf) {
+            len = 2;
+        } else if (byte >= 0xe0 && byte <= 0xef) {
+            len = 3;
+            if (byte == 0xe0) {
+                low = 0xa0;
+            } else if (byte == 0xed) {
+                high = 0x9f;
+            }
+        } else if (byte >= 0xf0 && byte <= 0xf4) {
+            len = 4;
+            if (byte == 0xf0) {
+                low = 0x90;
+            } else if (byte == 0xf4) {
+                high = 0x8f;
             }
         } else {
-            // Process "trailing digit".
-            if (byte >> 6 != 0b10) {
+            return false;
+        }
+        if (size - i < len || data[i + 1] < low || data[i + 1] > high) {
+            return false;
+        }
+        for (size_t k = 2; k < len; k++) {
+            if ((data[i + k] & 0xc0) != 0x80) {
                 return false;
             }
-            trailing_digits -= 1;
         }
+        i += len;
     }
-    return trailing_digits == 0;
+}
+
+inline bool is_valid_utf8(const std::string &input) {
+    return is_valid_utf8(reinterpret_cast<const uint8_t *>(input.data()),
+                         input.size());
 }
 
 template <class D>
 std::string BinaryDeserializer<D>::deserialize_str() {
-    auto len = static_cast<D *>(this)->deserialize_len();
     std::string result;
-    result.reserve(len);
-    for (size_t i = 0; i < len; i++) {
-        result.push_back(read_byte());
+    deserialize_str_into(result);
+    return result;
+}
+
+// Only strings that outgrow their capacity are charged.
+template <class D>
+template <typename Allocator>
+void BinaryDeserializer<D>::deserialize_str_into(
+    std::basic_string<char, std::char_traits<char>, Allocator> &value) {
+    auto len = static_cast<D *>(this)->deserialize_len();
+    auto src = read_bytes(len);
+    if (src == nullptr ||
+        (len > value.capacity() && !charge_allocation(len, 1))) {
+        value.clear();
+        return;
     }
-    if (!is_valid_utf8(result)) {
-        throw serde::deserialization_error("Invalid UTF8 string: " + result);
+    if (!is_valid_utf8(src, len)) {
+        fail("Invalid UTF8 string");
+        value.clear();
+        return;
     }
-    return result;
+    value.assign(reinterpret_cast<const char *>(src), len);
 }
 
 template <class D>
@@ -266,17 +1024,20 @@ std::monostate BinaryDeserializer<D>::deserialize_unit() {
 
 template <class D>
 float BinaryDeserializer<D>::deserialize_f32() {
-    throw serde::deserialization_error("not implemented");
+    fail("not implemented");
+    return 0;
 }
 
 template <class D>
 double BinaryDeserializer<D>::deserialize_f64() {
-    throw serde::deserialization_error("not implemented");
+    fail("not implemented");
+    return 0;
 }
 
 template <class D>
 char32_t BinaryDeserializer<D>::deserialize_char() {
-    throw serde::deserialization_error("not implemented");
+    fail("not implemented");
+    return 0;
 }
 
 template <class D>
@@ -287,7 +1048,8 @@ bool BinaryDeserializer<D>::deserialize_bool() {
     case 1:
         return true;
     default:
-        throw serde::deserialization_error("Invalid boolean value");
+        fail("Invalid boolean value");
+        return false;
     }
 }
 
@@ -298,41 +1060,28 @@ uint8_t BinaryDeserializer<D>::deserialize_u8() {
 
 template <class D>
 uint16_t BinaryDeserializer<D>::deserialize_u16() {
-    uint16_t val = 0;
-    val |= (uint16_t)read_byte();
-    val |= (uint16_t)read_byte() << 8;
-    return val;
+    return read_little_endian<uint16_t>();
 }
 
 template <class D>
 uint32_t BinaryDeserializer<D>::deserialize_u32() {
-    uint32_t val = 0;
-    val |= (uint32_t)read_byte();
-    val |= (uint32_t)read_byte() << 8;
-    val |= (uint32_t)read_byte() << 16;
-    val |= (uint32_t)read_byte() << 24;
-    return val;
+    return read_little_endian<uint32_t>();
 }
 
 template <class D>
 uint64_t BinaryDeserializer<D>::deserialize_u64() {
-    uint64_t val = 0;
-    val |= (uint64_t)read_byte();
-    val |= (uint64_t)read_byte() << 8;
-    val |= (uint64_t)read_byte() << 16;
-    val |= (uint64_t)read_byte() << 24;
-    val |= (uint64_t)read_byte() << 32;
-    val |= (uint64_t)read_byte() << 40;
-    val |= (uint64_t)read_byte() << 48;
-    val |= (uint64_t)read_byte() << 56;
-    return val;
+    return read_little_endian<uint64_t>();
 }
 
 template <class D>
 uint128_t BinaryDeserializer<D>::deserialize_u128() {
+    auto src = read_bytes(16);
+    if (src == nullptr) {
+        return {0, 0};
+    }
     uint128_t result;
-    result.low = deserialize_u64();
-    result.high = deserialize_u64();
+    result.low = load_little_endian<uint64_t>(src);
+    result.high = load_little_endian<uint64_t>(src + 8);
     return result;
 }
 
@@ -358,17 +1107,91 @@ int64_t BinaryDeserializer<D>::deserialize_i64() {
 
 template <class D>
 int128_t BinaryDeserializer<D>::deserialize_i128() {
+    auto src = read_bytes(16);
+    if (src == nullptr) {
+        return {0, 0};
+    }
     int128_t result;
-    result.low = deserialize_u64();
-    result.high = deserialize_i64();
+    result.low = load_little_endian<uint64_t>(src);
+    result.high = (int64_t)load_little_endian<uint64_t>(src + 8);
     return result;
 }
 
+#ifdef SERDE_HAS_INT128
+template <class D>
+native_uint128_t BinaryDeserializer<D>::deserialize_native_u128() {
+    auto src = read_bytes(16);
+    if (src == nullptr) {
+        return 0;
+    }
+    if constexpr (host_is_little_endian) {
+        native_uint128_t value;
+        std::memcpy(&value, src, 16);
+        return value;
+    } else {
+        return (native_uint128_t)load_little_endian<uint64_t>(src + 8) << 64 |
+               load_little_endian<uint64_t>(src);
+    }
+}
+
+template <class D>
+native_int128_t BinaryDeserializer<D>::deserialize_native_i128() {
+    return (native_int128_t)deserialize_native_u128();
+}
+#endif
+
 template <class D>
 bool BinaryDeserializer<D>::deserialize_option_tag() {
     return deserialize_bool();
 }
 
+template <class D>
+template <typename T>
+void BinaryDeserializer<D>::deserialize_array(T *dst, size_t n) {
+    auto src = read_array<T>(n);
+    if (src == nullptr) {
+        std::fill(dst, dst + n, T());
+        return;
+    }
+    load_array_little_endian(dst, src, n);
+}
+
+template <class D>
+template <typename T>
+std::vector<T> BinaryDeserializer<D>::deserialize_vector(size_t n) {
+    std::vector<T> result;
+    deserialize_vector_into(result, n);
+    return result;
+}
+
+template <class D>
+template <typename T, typename Allocator>
+void BinaryDeserializer<D>::deserialize_vector_into(
+    std::vector<T, Allocator> &value, size_t n) {
+    auto src = read_array<T>(n);
+    if (src == nullptr ||
+        (n > value.capacity() && !charge_allocation(n, sizeof(T)))) {
+        value.clear();
+        return;
+    }
+    if constexpr (std::is_same<T, bool>::value) {
+        // `std::vector<bool>` is a bitset.
+        value.assign(src, src + n);
+    } else {
+        value.resize(n);
+        load_array_little_endian(value.data(), src, n);
+    }
+}
+
+template <class D>
+bool BinaryDeserializer<D>::check_remaining_input(size_t n, size_t min_size) {
+    if (n > remaining() / min_size) {
+        fail("Input is not large enough");
+        return false;
+    }
+    return true;
+}
+
 template <class D>
 size_t BinaryDeserializer<D>::get_buffer_offset() {
     return pos_;
@@ -376,15 +1199,33 @@ size_t BinaryDeserializer<D>::get_buffer_offset() {
 
 template <class S>
 void BinaryDeserializer<S>::increase_container_depth() {
+    if constexpr (!S::limits_container_depth) {
+        return;
+    }
     if (container_depth_budget_ == 0) {
-        throw deserialization_error("Too many nested containers");
+        fail("Too many nested containers");
+        exhausted_container_depth_++;
+        return;
     }
     container_depth_budget_--;
 }
 
 template <class S>
 void BinaryDeserializer<S>::decrease_container_depth() {
-    container_depth_budget_++;
+    if constexpr (S::limits_container_depth) {
+        if (exhausted_container_depth_ > 0) {
+            exhausted_container_depth_--;
+        } else {
+            container_depth_budget_++;
+        }
+    }
+}
+
+template <class S>
+void BinaryDeserializer<S>::check_container_depth_budget(size_t depth) {
+    if (!has_container_depth_budget(depth)) {
+        fail("Too many nested containers");
+    }
 }
 
 } // end of namespace serde
@@ -4,6 +4,7 @@
 #pragma once
 
 #include <cstdint>
+#include <limits>
 
 #include "binary.hpp"
 #include "serde.hpp"
@@ -13,33 +14,75 @@ constexpr size_t BINCODE_MAX_LENGTH = (1ull << 31) - 1;
 
 namespace serde {
 
-class BincodeSerializer : public BinarySerializer<BincodeSerializer> {
-    using Parent = BinarySerializer<BincodeSerializer>;
+// Sizes used by Bincode for lengths (u64) and variant indices (u32), see
+// `encoded_size_bounds`.
+struct BincodeEncoding {
+    static constexpr SizeBounds len = {8, 8};
+    static constexpr SizeBounds variant_index = {4, 4};
+    // Indices below 256 only differ by their first (least significant) byte.
+    static constexpr size_t ordered_variant_count = 256;
+    static constexpr bool is_ordered_by_compare_encodings = false;
+    static constexpr bool has_floats = true;
+};
+
+template <class Sink = VectorSink>
+class BasicBincodeSerializer
+    : public BinarySerializer<BasicBincodeSerializer<Sink>, Sink> {
+    using Parent = BinarySerializer<BasicBincodeSerializer<Sink>, Sink>;
 
   public:
-    BincodeSerializer() : Parent(SIZE_MAX) {}
+    using encoding = BincodeEncoding;
+
+    BasicBincodeSerializer(Sink sink = Sink())
+        : Parent(SIZE_MAX, std::move(sink)) {}
 
     void serialize_f32(float value);
     void serialize_f64(double value);
     void serialize_len(size_t value);
     void serialize_variant_index(uint32_t value);
 
+    template <typename T>
+    static constexpr bool supports_bulk_array =
+        Parent::template supports_bulk_array<T> ||
+        std::is_floating_point<T>::value;
+
     static constexpr bool enforce_strict_map_ordering = false;
+    static constexpr bool limits_container_depth = false;
 };
 
+using BincodeSerializer = BasicBincodeSerializer<>;
+
 class BincodeDeserializer : public BinaryDeserializer<BincodeDeserializer> {
     using Parent = BinaryDeserializer<BincodeDeserializer>;
 
   public:
+    using encoding = BincodeEncoding;
+
     BincodeDeserializer(std::vector<uint8_t> bytes)
         : Parent(std::move(bytes), SIZE_MAX) {}
 
+    // Read borrowed bytes without copying them. The input must outlive the
+    // deserializer.
+    BincodeDeserializer(const uint8_t *data, size_t size)
+        : Parent(InputBuffer(data, size), SIZE_MAX) {}
+
+#ifdef SERDE_HAS_SPAN
+    BincodeDeserializer(std::span<const uint8_t> bytes)
+        : BincodeDeserializer(bytes.data(), bytes.size()) {}
+#endif
+
     float deserialize_f32();
     double deserialize_f64();
     size_t deserialize_len();
     uint32_t deserialize_variant_index();
 
+    template <typename T>
+    static constexpr bool supports_bulk_array =
+        Parent::template supports_bulk_array<T> ||
+        std::is_floating_point<T>::value;
+
     static constexpr bool enforce_strict_map_ordering = false;
+    static constexpr bool limits_container_depth = false;
 };
 
 // Native floats and doubles must be IEEE-754 values of the expected size.
@@ -48,39 +91,46 @@ static_assert(std::numeric_limits<double>::is_iec559);
 static_assert(sizeof(float) == sizeof(uint32_t));
 static_assert(sizeof(double) == sizeof(uint64_t));
 
-inline void BincodeSerializer::serialize_f32(float value) {
-    Parent::serialize_u32(*reinterpret_cast<uint32_t *>(&value));
+template <class Sink>
+void BasicBincodeSerializer<Sink>::serialize_f32(float value) {
+    Parent::serialize_array(&value, 1);
 }
 
-inline void BincodeSerializer::serialize_f64(double value) {
-    Parent::serialize_u64(*reinterpret_cast<uint64_t *>(&value));
+template <class Sink>
+void BasicBincodeSerializer<Sink>::serialize_f64(double value) {
+    Parent::serialize_array(&value, 1);
 }
 
-inline void BincodeSerializer::serialize_len(size_t value) {
+template <class Sink>
+void BasicBincodeSerializer<Sink>::serialize_len(size_t value) {
     if (value > BINCODE_MAX_LENGTH) {
-        throw serde::serialization_error("Length is too large");
+        SERDE_THROW(serialization_error("Length is too large"));
     }
     Parent::serialize_u64((uint64_t)value);
 }
 
-inline void BincodeSerializer::serialize_variant_index(uint32_t value) {
+template <class Sink>
+void BasicBincodeSerializer<Sink>::serialize_variant_index(uint32_t value) {
     Parent::serialize_u32((uint32_t)value);
 }
 
 inline float BincodeDeserializer::deserialize_f32() {
-    auto value = Parent::deserialize_u32();
-    return *reinterpret_cast<float *>(&value);
+    float value;
+    Parent::deserialize_array(&value, 1);
+    return value;
 }
 
 inline double BincodeDeserializer::deserialize_f64() {
-    auto value = Parent::deserialize_u64();
-    return *reinterpret_cast<double *>(&value);
+    double value;
+    Parent::deserialize_array(&value, 1);
+    return value;
 }
 
 inline size_t BincodeDeserializer::deserialize_len() {
     auto value = (size_t)Parent::deserialize_u64();
     if (value > BINCODE_MAX_LENGTH) {
-        throw serde::deserialization_error("Length is too large");
+        fail("Length is too large");
+        return 0;
     }
     return (size_t)value;
 }
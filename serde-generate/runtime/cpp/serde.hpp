@@ -3,21 +3,53 @@
 
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <cstddef>
 #include <cstdint>
+#include <cstdlib>
+#include <cstring>
 #include <functional>
 #include <map>
 #include <memory>
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#define SERDE_HAS_PMR 1
+#endif
 #include <optional>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <tuple>
 #include <type_traits>
+#include <utility>
 #include <variant>
 #include <vector>
 
+// Errors are thrown as exceptions unless exceptions are disabled (e.g. with
+// `-fno-exceptions`). In that case, deserialization errors must be handled
+// with the non-throwing API (see `deserialization_result`) and other errors
+// abort the program.
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS) || defined(_CPPUNWIND)
+#define SERDE_HAS_EXCEPTIONS 1
+#define SERDE_THROW(error) throw error
+#else
+#define SERDE_THROW(error) std::abort()
+#endif
+
+// Native 128-bit integers, when the compiler supports them (e.g. GCC and
+// Clang on 64-bit targets).
+#if defined(__SIZEOF_INT128__)
+#define SERDE_HAS_INT128 1
+#endif
+
 namespace serde {
 
+#ifdef SERDE_HAS_INT128
+__extension__ typedef unsigned __int128 native_uint128_t;
+__extension__ typedef __int128 native_int128_t;
+#endif
+
 class serialization_error : public std::invalid_argument {
   public:
     explicit serialization_error(const std::string &what_arg)
@@ -34,80 +66,298 @@ class deserialization_error : public std::invalid_argument {
         : std::invalid_argument(what_arg) {}
 };
 
-// Basic implementation for 128-bit unsigned integers.
+// Error raised when a deserializer exceeds its allocation budget. The
+// non-throwing API reports it with `message` itself (same address).
+class allocation_budget_exceeded : public deserialization_error {
+  public:
+    static constexpr char message[] = "Allocation budget exceeded";
+
+    allocation_budget_exceeded() : deserialization_error(message) {}
+};
+
+// Error reported by the non-throwing deserialization API: a static message
+// and the offset in the input where the error was detected.
+struct deserialization_failure {
+    const char *message;
+    size_t offset;
+};
+
+// Result of the non-throwing deserialization API, similar to
+// `std::expected<T, deserialization_failure>`.
+template <typename T>
+class deserialization_result {
+    std::variant<T, deserialization_failure> value_;
+
+  public:
+    deserialization_result(T value) : value_(std::move(value)) {}
+    deserialization_result(deserialization_failure failure)
+        : value_(failure) {}
+
+    bool has_value() const { return value_.index() == 0; }
+    explicit operator bool() const { return has_value(); }
+
+    // Requires `has_value()`.
+    T &value() & { return *std::get_if<0>(&value_); }
+    const T &value() const & { return *std::get_if<0>(&value_); }
+    T &&value() && { return std::move(*std::get_if<0>(&value_)); }
+    T &operator*() & { return value(); }
+    const T &operator*() const & { return value(); }
+    T *operator->() { return &value(); }
+    const T *operator->() const { return &value(); }
+
+    // Requires `!has_value()`.
+    const deserialization_failure &error() const {
+        return *std::get_if<1>(&value_);
+    }
+};
+
+// Basic implementation for 128-bit unsigned integers. Values are ordered
+// numerically. With compiler support, they convert from and to native
+// integers.
 struct uint128_t {
     uint64_t high;
     uint64_t low;
 
+    uint128_t() = default;
+    constexpr uint128_t(uint64_t high, uint64_t low) : high(high), low(low) {}
+#ifdef SERDE_HAS_INT128
+    constexpr explicit uint128_t(native_uint128_t value)
+        : high((uint64_t)(value >> 64)), low((uint64_t)value) {}
+    constexpr explicit operator native_uint128_t() const {
+        return (native_uint128_t)high << 64 | low;
+    }
+#endif
+
     friend bool operator==(const uint128_t &, const uint128_t &);
+    friend bool operator!=(const uint128_t &, const uint128_t &);
+    friend bool operator<(const uint128_t &, const uint128_t &);
+    friend bool operator<=(const uint128_t &, const uint128_t &);
+    friend bool operator>(const uint128_t &, const uint128_t &);
+    friend bool operator>=(const uint128_t &, const uint128_t &);
 };
 
 inline bool operator==(const uint128_t &lhs, const uint128_t &rhs) {
     return lhs.high == rhs.high && lhs.low == rhs.low;
 }
 
-// 128-bit signed integers.
+inline bool operator!=(const uint128_t &lhs, const uint128_t &rhs) {
+    return !(lhs == rhs);
+}
+
+inline bool operator<(const uint128_t &lhs, const uint128_t &rhs) {
+    return lhs.high < rhs.high || (lhs.high == rhs.high && lhs.low < rhs.low);
+}
+
+inline bool operator<=(const uint128_t &lhs, const uint128_t &rhs) {
+    return !(rhs < lhs);
+}
+
+inline bool operator>(const uint128_t &lhs, const uint128_t &rhs) {
+    return rhs < lhs;
+}
+
+inline bool operator>=(const uint128_t &lhs, const uint128_t &rhs) {
+    return !(lhs < rhs);
+}
+
+// 128-bit signed integers (in two's complement).
 struct int128_t {
     int64_t high;
     uint64_t low;
 
+    int128_t() = default;
+    constexpr int128_t(int64_t high, uint64_t low) : high(high), low(low) {}
+#ifdef SERDE_HAS_INT128
+    constexpr explicit int128_t(native_int128_t value)
+        : high((int64_t)(value >> 64)), low((uint64_t)value) {}
+    constexpr explicit operator native_int128_t() const {
+        return (native_int128_t)((native_uint128_t)(uint64_t)high << 64 | low);
+    }
+#endif
+
     friend bool operator==(const int128_t &, const int128_t &);
+    friend bool operator!=(const int128_t &, const int128_t &);
+    friend bool operator<(const int128_t &, const int128_t &);
+    friend bool operator<=(const int128_t &, const int128_t &);
+    friend bool operator>(const int128_t &, const int128_t &);
+    friend bool operator>=(const int128_t &, const int128_t &);
 };
 
 inline bool operator==(const int128_t &lhs, const int128_t &rhs) {
     return lhs.high == rhs.high && lhs.low == rhs.low;
 }
 
-// A copyable unique_ptr with value semantics.
+inline bool operator!=(const int128_t &lhs, const int128_t &rhs) {
+    return !(lhs == rhs);
+}
+
+inline bool operator<(const int128_t &lhs, const int128_t &rhs) {
+    return lhs.high < rhs.high || (lhs.high == rhs.high && lhs.low < rhs.low);
+}
+
+inline bool operator<=(const int128_t &lhs, const int128_t &rhs) {
+    return !(rhs < lhs);
+}
+
+inline bool operator>(const int128_t &lhs, const int128_t &rhs) {
+    return rhs < lhs;
+}
+
+inline bool operator>=(const int128_t &lhs, const int128_t &rhs) {
+    return !(lhs < rhs);
+}
+
+// Without compiler support, "native" 128-bit integers are the structs above.
+// Generated code uses these types when configured to use native integers.
+#ifndef SERDE_HAS_INT128
+using native_uint128_t = uint128_t;
+using native_int128_t = int128_t;
+#endif
+
+// A copyable unique_ptr with value semantics. Values are allocated with
+// `Allocator` (see also `serde::pmr::value_ptr`). Like standard containers,
+// a `value_ptr` keeps its allocator when assigned.
 // Freely inspired by the following discussion:
 // https://codereview.stackexchange.com/questions/103744/deepptr-a-deep-copying-unique-ptr-wrapper-in-c
-template <typename T>
+template <typename T, typename Allocator = std::allocator<T>>
 class value_ptr {
+    using traits = std::allocator_traits<Allocator>;
+
   public:
-    value_ptr() : ptr_(nullptr) {}
+    using allocator_type = Allocator;
+
+    value_ptr() : storage_{Allocator(), nullptr} {}
+
+    explicit value_ptr(const Allocator &alloc) : storage_{alloc, nullptr} {}
+
+    value_ptr(const T &value)
+        : value_ptr(std::allocator_arg, Allocator(), value) {}
 
-    value_ptr(const T &value) : ptr_(new T{value}) {}
+    // Move `value` to the heap without copying its content (e.g. the tail of
+    // a recursive list).
+    value_ptr(T &&value)
+        : value_ptr(std::allocator_arg, Allocator(), std::move(value)) {}
+
+    // Construct a `T` from `args` (with braces) in memory obtained from
+    // `alloc`.
+    template <typename... Args>
+    value_ptr(std::allocator_arg_t, const Allocator &alloc, Args &&... args)
+        : storage_{alloc, nullptr} {
+        storage_.ptr = create(std::forward<Args>(args)...);
+    }
+
+    // Requires the default allocator.
+    explicit value_ptr(std::unique_ptr<T> ptr)
+        : storage_{Allocator(), ptr.release()} {
+        static_assert(std::is_same<Allocator, std::allocator<T>>::value);
+    }
 
-    value_ptr(const value_ptr &other) : ptr_(nullptr) {
+    value_ptr(const value_ptr &other)
+        : storage_{traits::select_on_container_copy_construction(
+                       other.storage_),
+                   nullptr} {
         if (other) {
-            ptr_ = std::unique_ptr<T>{new T{*other}};
+            storage_.ptr = create(*other);
         }
     }
 
     value_ptr &operator=(const value_ptr &other) {
-        value_ptr temp{other};
-        std::swap(ptr_, temp.ptr_);
+        value_ptr temp =
+            other ? value_ptr(std::allocator_arg, get_allocator(), *other)
+                  : value_ptr(get_allocator());
+        std::swap(storage_.ptr, temp.storage_.ptr);
         return *this;
     }
 
-    value_ptr(value_ptr &&other) = default;
+    value_ptr(value_ptr &&other) noexcept
+        : storage_{other.storage_, std::exchange(other.storage_.ptr, nullptr)} {
+    }
+
+    // Values owned by another allocator are moved, not their memory.
+    value_ptr &operator=(value_ptr &&other) {
+        value_ptr temp(get_allocator());
+        if (get_allocator() == other.get_allocator()) {
+            std::swap(temp.storage_.ptr, other.storage_.ptr);
+        } else if (other) {
+            temp.storage_.ptr = temp.create(std::move(*other));
+        }
+        std::swap(storage_.ptr, temp.storage_.ptr);
+        return *this;
+    }
+
+    ~value_ptr() {
+        if (storage_.ptr != nullptr) {
+            storage_.ptr->~T();
+            traits::deallocate(storage_, storage_.ptr, 1);
+        }
+    }
 
-    value_ptr &operator=(value_ptr &&other) = default;
+    T &operator*() { return *storage_.ptr; }
 
-    T &operator*() { return *ptr_; }
+    const T &operator*() const { return *storage_.ptr; }
 
-    const T &operator*() const { return *ptr_; }
+    T *const operator->() { return storage_.ptr; }
 
-    T *const operator->() { return ptr_.operator->(); }
+    const T *const operator->() const { return storage_.ptr; }
 
-    const T *const operator->() const { return ptr_.operator->(); }
+    const T *const get() const { return storage_.ptr; }
 
-    const T *const get() const { return ptr_.get(); }
+    operator bool() const { return storage_.ptr != nullptr; }
 
-    operator bool() const { return (bool)ptr_; }
+    Allocator get_allocator() const { return storage_; }
 
-    template <typename U>
-    friend bool operator==(const value_ptr<U> &, const value_ptr<U> &);
+    template <typename U, typename A>
+    friend bool operator==(const value_ptr<U, A> &, const value_ptr<U, A> &);
 
   private:
-    std::unique_ptr<T> ptr_;
+    // The allocator is a base class so that stateless allocators take no
+    // space.
+    struct storage : Allocator {
+        T *ptr;
+    };
+
+    template <typename... Args>
+    T *create(Args &&... args) {
+        // Release the memory if the constructor of `T` throws.
+        struct guard {
+            Allocator &alloc;
+            T *ptr;
+            ~guard() {
+                if (ptr != nullptr) {
+                    traits::deallocate(alloc, ptr, 1);
+                }
+            }
+        } memory{storage_, traits::allocate(storage_, 1)};
+        new (memory.ptr) T{std::forward<Args>(args)...};
+        return std::exchange(memory.ptr, nullptr);
+    }
+
+    storage storage_;
 };
 
-template <typename T>
-bool operator==(const value_ptr<T> &lhs, const value_ptr<T> &rhs) {
+template <typename T, typename Allocator>
+bool operator==(const value_ptr<T, Allocator> &lhs,
+                const value_ptr<T, Allocator> &rhs) {
     return *lhs == *rhs;
 }
 
+// Construct a `T` directly on the heap, similarly to `std::make_unique`.
+template <typename T, typename... Args>
+value_ptr<T> make_value(Args &&... args) {
+    return value_ptr<T>(std::allocator_arg, std::allocator<T>(),
+                        std::forward<Args>(args)...);
+}
+
+#ifdef SERDE_HAS_PMR
+namespace pmr {
+
+// Value pointers allocating from a `std::pmr::memory_resource`.
+template <typename T>
+using value_ptr = serde::value_ptr<T, std::pmr::polymorphic_allocator<T>>;
+
+} // end of namespace pmr
+#endif
+
 // Trait to enable serialization of values of type T.
 // This is similar to the `serde::Serialize` trait in Rust.
 template <typename T>
@@ -122,15 +372,178 @@ template <typename T>
 struct Deserializable {
     template <typename Deserializer>
     static T deserialize(Deserializer &deserializer);
+
+    // Overwrite an existing value. Generated types reuse the memory owned by
+    // their fields.
+    template <typename Deserializer>
+    static void deserialize_into(T &value, Deserializer &deserializer) {
+        value = deserialize(deserializer);
+    }
+};
+
+template <typename T, typename Deserializer, typename = void>
+struct has_deserialize_into : std::false_type {};
+
+template <typename T, typename Deserializer>
+struct has_deserialize_into<
+    T, Deserializer,
+    std::void_t<decltype(Deserializable<T>::deserialize_into(
+        std::declval<T &>(), std::declval<Deserializer &>()))>>
+    : std::true_type {};
+
+// Deserialize into an existing value, reusing the capacity of strings and
+// vectors, the nodes of maps, and the storage of options, `value_ptr` and
+// matching variant alternatives. Other values are simply assigned. After an
+// error, `value` is unspecified.
+template <typename T, typename Deserializer>
+void deserialize_into(T &value, Deserializer &deserializer) {
+    if constexpr (has_deserialize_into<T, Deserializer>::value) {
+        Deserializable<T>::deserialize_into(value, deserializer);
+    } else {
+        value = Deserializable<T>::deserialize(deserializer);
+    }
+}
+
+template <typename Allocator>
+struct is_polymorphic_allocator : std::false_type {};
+
+#ifdef SERDE_HAS_PMR
+template <typename T>
+struct is_polymorphic_allocator<std::pmr::polymorphic_allocator<T>>
+    : std::true_type {};
+#endif
+
+// Allocator of the values created by a deserializer. Polymorphic allocators
+// use the memory resource of the deserializer.
+template <typename Allocator, typename Deserializer>
+Allocator make_allocator(Deserializer &deserializer) {
+    if constexpr (is_polymorphic_allocator<Allocator>::value) {
+        return Allocator(deserializer.memory_resource());
+    } else {
+        return Allocator();
+    }
+}
+
+// Bounds on the number of bytes used by an encoding. `max` is SIZE_MAX when
+// the size is unbounded.
+struct SizeBounds {
+    size_t min;
+    size_t max;
+
+    constexpr bool is_fixed() const { return min == max; }
+
+    constexpr bool is_bounded() const { return max != SIZE_MAX; }
+
+    // Bounds for a value followed by another one.
+    constexpr SizeBounds operator+(SizeBounds other) const {
+        return {saturating_add(min, other.min),
+                saturating_add(max, other.max)};
+    }
+
+    // Bounds for one value or another one.
+    constexpr SizeBounds operator|(SizeBounds other) const {
+        return {min < other.min ? min : other.min,
+                max > other.max ? max : other.max};
+    }
+
+    // Bounds for `n` values in a row.
+    constexpr SizeBounds operator*(size_t n) const {
+        return {saturating_mul(min, n), saturating_mul(max, n)};
+    }
+
+  private:
+    static constexpr size_t saturating_add(size_t x, size_t y) {
+        return x > SIZE_MAX - y ? SIZE_MAX : x + y;
+    }
+
+    static constexpr size_t saturating_mul(size_t x, size_t n) {
+        return n != 0 && x > SIZE_MAX / n ? SIZE_MAX : x * n;
+    }
+};
+
+// Trait to compute bounds on the size of the encoding of values of type T.
+// `Encoding` describes the sizes used by a particular format for lengths
+// and variant indices (see e.g. `BcsEncoding`). Types without a
+// specialization (e.g. external definitions) are assumed unbounded.
+template <typename T>
+struct EncodedSizeBounds {
+    template <typename Encoding>
+    static constexpr SizeBounds bounds() {
+        return {0, SIZE_MAX};
+    }
+};
+
+template <typename T, typename Encoding>
+constexpr SizeBounds encoded_size_bounds =
+    EncodedSizeBounds<T>::template bounds<Encoding>();
+
+// Trait telling whether `operator<` on values of type T agrees with the
+// lexicographic order of their encodings. Maps with such keys are already in
+// the canonical order required by some formats (e.g. BCS). Defaults to false.
+template <typename T>
+struct EncodedOrder {
+    template <typename Encoding>
+    static constexpr bool matches_less() {
+        return false;
+    }
+};
+
+template <typename T, typename Encoding>
+constexpr bool encoded_order_matches_less =
+    EncodedOrder<T>::template matches_less<Encoding>();
+
+// Trait to compare values following the lexicographic order of their BCS
+// encodings, without encoding them. Generated types define `operator<` this
+// way, so that maps keyed by these types are in canonical order. Other types
+// (e.g. external definitions) should specialize this trait: otherwise, the
+// default implementation in `bcs.hpp` serializes the values.
+template <typename T>
+struct EncodedComparison {
+    static int compare(const T &lhs, const T &rhs);
+};
+
+// Returns a negative value, zero, or a positive value when the BCS encoding of
+// `lhs` is respectively smaller than, equal to, or greater than the one of
+// `rhs`.
+template <typename T>
+int compare_encodings(const T &lhs, const T &rhs) {
+    return EncodedComparison<T>::compare(lhs, rhs);
+}
+
+// Trait to hash values consistently with `operator==`. Defaults to
+// `std::hash`. Generated types specialize `std::hash` using this trait for
+// their fields.
+template <typename T>
+struct Hashable {
+    static size_t hash(const T &value) { return std::hash<T>{}(value); }
 };
 
+template <typename T>
+size_t hash_value(const T &value) {
+    return Hashable<T>::hash(value);
+}
+
+// Mix the hash of a component into the hash `seed` of the previous ones.
+inline size_t hash_combine(size_t seed, size_t hash) {
+    uint64_t x = (uint64_t)seed + 0x9e3779b97f4a7c15ull + hash;
+    x ^= x >> 32;
+    x *= 0xe9846af9b1a615dull;
+    x ^= x >> 32;
+    x *= 0xe9846af9b1a615dull;
+    x ^= x >> 28;
+    return (size_t)x;
+}
+
 // --- Implementation of Serializable for base types ---
 
 // string
-template <>
-struct Serializable<std::string> {
+template <typename Allocator>
+struct Serializable<
+    std::basic_string<char, std::char_traits<char>, Allocator>> {
+    using String = std::basic_string<char, std::char_traits<char>, Allocator>;
+
     template <typename Serializer>
-    static void serialize(const std::string &value, Serializer &serializer) {
+    static void serialize(const String &value, Serializer &serializer) {
         serializer.serialize_str(value);
     }
 };
@@ -271,13 +684,36 @@ struct Serializable<int128_t> {
     }
 };
 
+#ifdef SERDE_HAS_INT128
+// Native u128
+template <>
+struct Serializable<native_uint128_t> {
+    template <typename Serializer>
+    static void serialize(const native_uint128_t &value,
+                          Serializer &serializer) {
+        serializer.serialize_u128(value);
+    }
+};
+
+// Native i128
+template <>
+struct Serializable<native_int128_t> {
+    template <typename Serializer>
+    static void serialize(const native_int128_t &value,
+                          Serializer &serializer) {
+        serializer.serialize_i128(value);
+    }
+};
+#endif
+
 // --- Derivation of Serializable for composite types ---
 
 // Value pointers (non-nullable)
-template <typename T>
-struct Serializable<value_ptr<T>> {
+template <typename T, typename Allocator>
+struct Serializable<value_ptr<T, Allocator>> {
     template <typename Serializer>
-    static void serialize(const value_ptr<T> &value, Serializer &serializer) {
+    static void serialize(const value_ptr<T, Allocator> &value,
+                          Serializer &serializer) {
         Serializable<T>::serialize(*value, serializer);
     }
 };
@@ -304,8 +740,14 @@ struct Serializable<std::vector<T, Allocator>> {
     static void serialize(const std::vector<T, Allocator> &value,
                           Serializer &serializer) {
         serializer.serialize_len(value.size());
-        for (const T &item : value) {
-            Serializable<T>::serialize(item, serializer);
+        // The elements of `std::vector<bool>` are not stored contiguously.
+        if constexpr (Serializer::template supports_bulk_array<T> &&
+                      !std::is_same<T, bool>::value) {
+            serializer.serialize_array(value.data(), value.size());
+        } else {
+            for (const T &item : value) {
+                Serializable<T>::serialize(item, serializer);
+            }
         }
     }
 };
@@ -316,29 +758,91 @@ struct Serializable<std::array<T, N>> {
     template <typename Serializer>
     static void serialize(const std::array<T, N> &value,
                           Serializer &serializer) {
-        for (const T &item : value) {
-            Serializable<T>::serialize(item, serializer);
+        if constexpr (Serializer::template supports_bulk_array<T>) {
+            serializer.serialize_array(value.data(), N);
+        } else {
+            for (const T &item : value) {
+                Serializable<T>::serialize(item, serializer);
+            }
         }
     }
 };
 
 // Maps
-template <typename K, typename V, typename Allocator>
-struct Serializable<std::map<K, V, Allocator>> {
+template <typename K, typename V, typename Compare, typename Allocator>
+struct Serializable<std::map<K, V, Compare, Allocator>> {
     template <typename Serializer>
-    static void serialize(const std::map<K, V, Allocator> &value,
+    static void serialize(const std::map<K, V, Compare, Allocator> &value,
                           Serializer &serializer) {
-        serializer.serialize_len(value.size());
-        std::vector<size_t> offsets;
-        for (const auto &item : value) {
-            if constexpr (Serializer::enforce_strict_map_ordering) {
-                offsets.push_back(serializer.get_buffer_offset());
+        if constexpr (must_buffer_entries<Serializer>()) {
+            // Sort the entries in memory before they reach the sink.
+            serializer.serialize_buffered([&value](auto &buffered) {
+                Serializable<std::map<K, V, Compare, Allocator>>::serialize(
+                    value, buffered);
+            });
+        } else if constexpr (must_track_entries<Serializer>()) {
+            serializer.serialize_len(value.size());
+            auto marker = serializer.begin_map_entries();
+            for (const auto &item : value) {
+                serializer.begin_map_entry();
+                Serializable<K>::serialize(item.first, serializer);
+                Serializable<V>::serialize(item.second, serializer);
+            }
+            if constexpr (must_sort_entries<Serializer>()) {
+                serializer.sort_last_entries(marker);
+            } else {
+                serializer.check_last_entries(marker);
+            }
+        } else {
+            serializer.serialize_len(value.size());
+            for (const auto &item : value) {
+                Serializable<K>::serialize(item.first, serializer);
+                Serializable<V>::serialize(item.second, serializer);
             }
-            Serializable<K>::serialize(item.first, serializer);
-            Serializable<V>::serialize(item.second, serializer);
         }
+    }
+
+  private:
+    // Whether the serializer requires entries sorted by their encodings and
+    // the order of the map does not already guarantee it.
+    template <typename Serializer>
+    static constexpr bool must_sort_entries() {
         if constexpr (Serializer::enforce_strict_map_ordering) {
-            serializer.sort_last_entries(std::move(offsets));
+            constexpr bool is_less = std::is_same_v<Compare, std::less<K>> ||
+                                     std::is_same_v<Compare, std::less<>>;
+            return !is_less ||
+                   !encoded_order_matches_less<K,
+                                               typename Serializer::encoding>;
+        } else {
+            return false;
+        }
+    }
+
+    // Whether entries must be sorted but the output of the serializer cannot
+    // be re-ordered in place.
+    template <typename Serializer>
+    static constexpr bool must_buffer_entries() {
+        if constexpr (must_sort_entries<Serializer>()) {
+            return !Serializer::sink_type::is_random_access;
+        } else {
+            return false;
+        }
+    }
+
+    // Whether the offsets of entries must be recorded, either to sort them,
+    // or to check their order in debug builds.
+    template <typename Serializer>
+    static constexpr bool must_track_entries() {
+        if constexpr (must_sort_entries<Serializer>()) {
+            return true;
+        } else if constexpr (Serializer::enforce_strict_map_ordering) {
+#ifdef NDEBUG
+            return false;
+#else
+            return Serializer::sink_type::is_random_access;
+#endif
+        } else {
+            return false;
         }
     }
 };
@@ -364,26 +868,55 @@ struct Serializable<std::variant<Types...>> {
     template <typename Serializer>
     static void serialize(const std::variant<Types...> &value,
                           Serializer &serializer) {
+        auto index = value.index();
+        if (index == std::variant_npos) {
+            SERDE_THROW(
+                serialization_error("Cannot serialize valueless variant"));
+        }
         // Write the variant index.
-        serializer.serialize_variant_index(value.index());
-        // Visit the inner type.
-        std::visit(
-            [&serializer](const auto &arg) {
-                using T = typename std::decay<decltype(arg)>::type;
-                Serializable<T>::serialize(arg, serializer);
-            },
-            value);
+        serializer.serialize_variant_index(index);
+        // Dispatch to the inner type with a table of function pointers.
+        serialize_case(value, serializer, index,
+                       std::index_sequence_for<Types...>{});
+    }
+
+  private:
+    template <typename Serializer, size_t... Indices>
+    static void serialize_case(const std::variant<Types...> &value,
+                               Serializer &serializer, size_t index,
+                               std::index_sequence<Indices...>) {
+        using Case = void (*)(const std::variant<Types...> &, Serializer &);
+        static constexpr Case cases[] = {
+            &serialize_alternative<Serializer, Indices>...};
+        cases[index](value, serializer);
+    }
+
+    template <typename Serializer, size_t Index>
+    static void serialize_alternative(const std::variant<Types...> &value,
+                                      Serializer &serializer) {
+        using T = std::variant_alternative_t<Index, std::variant<Types...>>;
+        Serializable<T>::serialize(*std::get_if<Index>(&value), serializer);
     }
 };
 
 // --- Implementation of Deserializable for base types ---
 
 // string
-template <>
-struct Deserializable<std::string> {
+template <typename Allocator>
+struct Deserializable<
+    std::basic_string<char, std::char_traits<char>, Allocator>> {
+    using String = std::basic_string<char, std::char_traits<char>, Allocator>;
+
+    template <typename Deserializer>
+    static String deserialize(Deserializer &deserializer) {
+        String result(make_allocator<Allocator>(deserializer));
+        deserializer.deserialize_str_into(result);
+        return result;
+    }
+
     template <typename Deserializer>
-    static std::string deserialize(Deserializer &deserializer) {
-        return deserializer.deserialize_str();
+    static void deserialize_into(String &value, Deserializer &deserializer) {
+        deserializer.deserialize_str_into(value);
     }
 };
 
@@ -522,14 +1055,52 @@ struct Deserializable<int128_t> {
     }
 };
 
+#ifdef SERDE_HAS_INT128
+// Native u128
+template <>
+struct Deserializable<native_uint128_t> {
+    template <typename Deserializer>
+    static native_uint128_t deserialize(Deserializer &deserializer) {
+        return deserializer.deserialize_native_u128();
+    }
+};
+
+// Native i128
+template <>
+struct Deserializable<native_int128_t> {
+    template <typename Deserializer>
+    static native_int128_t deserialize(Deserializer &deserializer) {
+        return deserializer.deserialize_native_i128();
+    }
+};
+#endif
+
 // --- Derivation of Deserializable for composite types ---
 
 // Value pointers
-template <typename T>
-struct Deserializable<value_ptr<T>> {
+template <typename T, typename Allocator>
+struct Deserializable<value_ptr<T, Allocator>> {
+    template <typename Deserializer>
+    static value_ptr<T, Allocator> deserialize(Deserializer &deserializer) {
+        auto alloc = make_allocator<Allocator>(deserializer);
+        // After a recorded error, do not follow recursive types any further.
+        if (deserializer.has_failed() ||
+            !deserializer.charge_allocation(1, sizeof(T))) {
+            return value_ptr<T, Allocator>(alloc);
+        }
+        return value_ptr<T, Allocator>(
+            std::allocator_arg, alloc,
+            Deserializable<T>::deserialize(deserializer));
+    }
+
     template <typename Deserializer>
-    static value_ptr<T> deserialize(Deserializer &deserializer) {
-        return value_ptr<T>(Deserializable<T>::deserialize(deserializer));
+    static void deserialize_into(value_ptr<T, Allocator> &value,
+                                 Deserializer &deserializer) {
+        if (!value) {
+            value = deserialize(deserializer);
+        } else if (!deserializer.has_failed()) {
+            serde::deserialize_into(*value, deserializer);
+        }
     }
 };
 
@@ -545,49 +1116,210 @@ struct Deserializable<std::optional<T>> {
             return {Deserializable<T>::deserialize(deserializer)};
         }
     }
+
+    template <typename Deserializer>
+    static void deserialize_into(std::optional<T> &value,
+                                 Deserializer &deserializer) {
+        auto tag = deserializer.deserialize_option_tag();
+        if (!tag) {
+            value.reset();
+        } else if (value.has_value()) {
+            serde::deserialize_into(*value, deserializer);
+        } else {
+            value.emplace(Deserializable<T>::deserialize(deserializer));
+        }
+    }
 };
 
 // Vectors
 template <typename T, typename Allocator>
 struct Deserializable<std::vector<T, Allocator>> {
     template <typename Deserializer>
-    static std::vector<T> deserialize(Deserializer &deserializer) {
-        std::vector<T> result;
+    static std::vector<T, Allocator> deserialize(Deserializer &deserializer) {
         size_t len = deserializer.deserialize_len();
-        for (size_t i = 0; i < len; i++) {
-            result.push_back(Deserializable<T>::deserialize(deserializer));
+        std::vector<T, Allocator> result(
+            make_allocator<Allocator>(deserializer));
+        if constexpr (Deserializer::template supports_bulk_array<T>) {
+            deserializer.deserialize_vector_into(result, len);
+            return result;
+        } else {
+            // Values of a positive minimum size bound the length by the
+            // size of the input. Only then is it safe to reserve memory.
+            constexpr size_t min_size =
+                encoded_size_bounds<T, typename Deserializer::encoding>.min;
+            if constexpr (min_size > 0) {
+                if (!deserializer.check_remaining_input(len, min_size)) {
+                    return result;
+                }
+            }
+            if (!deserializer.charge_allocation(len, sizeof(T))) {
+                return result;
+            }
+            if constexpr (min_size > 0) {
+                result.reserve(len);
+            }
+            for (size_t i = 0; i < len && !deserializer.has_failed(); i++) {
+                result.push_back(Deserializable<T>::deserialize(deserializer));
+            }
+            return result;
+        }
+    }
+
+    // Existing elements are overwritten in place. Memory is only charged
+    // and reserved when the capacity is not sufficient.
+    template <typename Deserializer>
+    static void deserialize_into(std::vector<T, Allocator> &value,
+                                 Deserializer &deserializer) {
+        size_t len = deserializer.deserialize_len();
+        if constexpr (Deserializer::template supports_bulk_array<T>) {
+            deserializer.deserialize_vector_into(value, len);
+        } else {
+            constexpr size_t min_size =
+                encoded_size_bounds<T, typename Deserializer::encoding>.min;
+            if constexpr (min_size > 0) {
+                if (!deserializer.check_remaining_input(len, min_size)) {
+                    value.clear();
+                    return;
+                }
+            }
+            if (len > value.capacity() &&
+                !deserializer.charge_allocation(len, sizeof(T))) {
+                value.clear();
+                return;
+            }
+            if constexpr (min_size > 0) {
+                value.reserve(len);
+            }
+            if (value.size() > len) {
+                value.erase(value.begin() + len, value.end());
+            }
+            size_t i = 0;
+            for (; i < value.size() && !deserializer.has_failed(); i++) {
+                serde::deserialize_into(value[i], deserializer);
+            }
+            for (; i < len && !deserializer.has_failed(); i++) {
+                value.push_back(Deserializable<T>::deserialize(deserializer));
+            }
         }
-        return result;
     }
 };
 
 // Maps
-template <typename K, typename V>
-struct Deserializable<std::map<K, V>> {
+template <typename K, typename V, typename Compare, typename Allocator>
+struct Deserializable<std::map<K, V, Compare, Allocator>> {
+    template <typename Deserializer>
+    static std::map<K, V, Compare, Allocator>
+    deserialize(Deserializer &deserializer) {
+        std::map<K, V, Compare, Allocator> result(
+            make_allocator<Allocator>(deserializer));
+        size_t len = deserializer.deserialize_len();
+        constexpr size_t min_size =
+            (encoded_size_bounds<K, typename Deserializer::encoding> +
+             encoded_size_bounds<V, typename Deserializer::encoding>)
+                .min;
+        if constexpr (min_size > 0) {
+            if (!deserializer.check_remaining_input(len, min_size)) {
+                return result;
+            }
+        }
+        // Approximate size of a tree node: the entry, three pointers and
+        // a color.
+        constexpr size_t node_size =
+            sizeof(std::pair<const K, V>) + 4 * sizeof(void *);
+        if (!deserializer.charge_allocation(len, node_size)) {
+            return result;
+        }
+        std::optional<std::tuple<size_t, size_t>> previous_key_slice;
+        for (size_t i = 0; i < len; i++) {
+            auto start = deserializer.get_buffer_offset();
+            auto key = Deserializable<K>::deserialize(deserializer);
+            // After a recorded error, keys and values may hold null
+            // `value_ptr`s, which cannot be compared. Stop before inserting.
+            if (deserializer.has_failed()) {
+                break;
+            }
+            check_key_order(deserializer, previous_key_slice, start);
+            auto value = Deserializable<V>::deserialize(deserializer);
+            if (deserializer.has_failed()) {
+                break;
+            }
+            // Entries typically arrive in increasing order, in which case
+            // the end of the map is the right place for them. Otherwise,
+            // the hint is ignored. Duplicate keys are ignored as well.
+            result.emplace_hint(result.end(), std::move(key), std::move(value));
+        }
+        return result;
+    }
+
+    // The nodes of the existing entries are extracted and overwritten in
+    // place (keys included) before new nodes are allocated.
     template <typename Deserializer>
-    static std::map<K, V> deserialize(Deserializer &deserializer) {
-        std::map<K, V> result;
+    static void deserialize_into(std::map<K, V, Compare, Allocator> &value,
+                                 Deserializer &deserializer) {
+        std::map<K, V, Compare, Allocator> nodes(value.key_comp(),
+                                                 value.get_allocator());
+        nodes.swap(value);
         size_t len = deserializer.deserialize_len();
+        constexpr size_t min_size =
+            (encoded_size_bounds<K, typename Deserializer::encoding> +
+             encoded_size_bounds<V, typename Deserializer::encoding>)
+                .min;
+        if constexpr (min_size > 0) {
+            if (!deserializer.check_remaining_input(len, min_size)) {
+                return;
+            }
+        }
+        constexpr size_t node_size =
+            sizeof(std::pair<const K, V>) + 4 * sizeof(void *);
+        if (len > nodes.size() &&
+            !deserializer.charge_allocation(len - nodes.size(), node_size)) {
+            return;
+        }
         std::optional<std::tuple<size_t, size_t>> previous_key_slice;
         for (size_t i = 0; i < len; i++) {
-            if constexpr (Deserializer::enforce_strict_map_ordering) {
-                auto start = deserializer.get_buffer_offset();
+            auto start = deserializer.get_buffer_offset();
+            if (nodes.empty()) {
                 auto key = Deserializable<K>::deserialize(deserializer);
-                auto end = deserializer.get_buffer_offset();
-                if (previous_key_slice.has_value()) {
-                    deserializer.check_that_key_slices_are_increasing(
-                        previous_key_slice.value(), {start, end});
+                if (deserializer.has_failed()) {
+                    break;
+                }
+                check_key_order(deserializer, previous_key_slice, start);
+                auto mapped = Deserializable<V>::deserialize(deserializer);
+                if (deserializer.has_failed()) {
+                    break;
                 }
-                previous_key_slice = {start, end};
-                auto value = Deserializable<V>::deserialize(deserializer);
-                result.insert({key, value});
+                value.emplace_hint(value.end(), std::move(key),
+                                   std::move(mapped));
             } else {
-                auto key = Deserializable<K>::deserialize(deserializer);
-                auto value = Deserializable<V>::deserialize(deserializer);
-                result.insert({key, value});
+                auto node = nodes.extract(nodes.begin());
+                serde::deserialize_into(node.key(), deserializer);
+                if (deserializer.has_failed()) {
+                    break;
+                }
+                check_key_order(deserializer, previous_key_slice, start);
+                serde::deserialize_into(node.mapped(), deserializer);
+                if (deserializer.has_failed()) {
+                    break;
+                }
+                value.insert(value.end(), std::move(node));
             }
         }
-        return result;
+    }
+
+  private:
+    template <typename Deserializer>
+    static void check_key_order(
+        Deserializer &deserializer,
+        std::optional<std::tuple<size_t, size_t>> &previous_key_slice,
+        size_t start) {
+        if constexpr (Deserializer::enforce_strict_map_ordering) {
+            auto end = deserializer.get_buffer_offset();
+            if (previous_key_slice.has_value()) {
+                deserializer.check_that_key_slices_are_increasing(
+                    previous_key_slice.value(), {start, end});
+            }
+            previous_key_slice = {start, end};
+        }
     }
 };
 
@@ -596,22 +1328,60 @@ template <typename T, std::size_t N>
 struct Deserializable<std::array<T, N>> {
     template <typename Deserializer>
     static std::array<T, N> deserialize(Deserializer &deserializer) {
-        std::array<T, N> result;
-        for (T &item : result) {
-            item = Deserializable<T>::deserialize(deserializer);
+        if constexpr (Deserializer::template supports_bulk_array<T>) {
+            std::array<T, N> result;
+            deserializer.deserialize_array(result.data(), N);
+            return result;
+        } else {
+            return deserialize_items(deserializer,
+                                     std::make_index_sequence<N>{});
         }
-        return result;
     }
-};
 
-// Tuples
-template <class... Types>
-struct Deserializable<std::tuple<Types...>> {
     template <typename Deserializer>
-    static std::tuple<Types...> deserialize(Deserializer &deserializer) {
-        // Visit each of the type components.
-        return std::make_tuple(
-            Deserializable<Types>::deserialize(deserializer)...);
+    static void deserialize_into(std::array<T, N> &value,
+                                 Deserializer &deserializer) {
+        if constexpr (Deserializer::template supports_bulk_array<T>) {
+            deserializer.deserialize_array(value.data(), N);
+        } else {
+            for (T &item : value) {
+                serde::deserialize_into(item, deserializer);
+            }
+        }
+    }
+
+  private:
+    // Items are constructed in place, not default-constructed then assigned
+    // (e.g. with the default memory resource). Braced initialization
+    // guarantees that items are read from left to right.
+    template <typename Deserializer, size_t... Indices>
+    static std::array<T, N> deserialize_items(Deserializer &deserializer,
+                                              std::index_sequence<Indices...>) {
+        return std::array<T, N>{
+            {((void)Indices, Deserializable<T>::deserialize(deserializer))...}};
+    }
+};
+
+// Tuples
+template <class... Types>
+struct Deserializable<std::tuple<Types...>> {
+    template <typename Deserializer>
+    static std::tuple<Types...> deserialize(Deserializer &deserializer) {
+        // Visit each of the type components. Braced initialization
+        // guarantees that components are read from left to right.
+        return std::tuple<Types...>{
+            Deserializable<Types>::deserialize(deserializer)...};
+    }
+
+    template <typename Deserializer>
+    static void deserialize_into(std::tuple<Types...> &value,
+                                 Deserializer &deserializer) {
+        // Comma folds are evaluated from left to right.
+        std::apply(
+            [&deserializer](Types &... args) {
+                (serde::deserialize_into(args, deserializer), ...);
+            },
+            value);
     }
 };
 
@@ -620,31 +1390,730 @@ template <class... Types>
 struct Deserializable<std::variant<Types...>> {
     template <typename Deserializer>
     static std::variant<Types...> deserialize(Deserializer &deserializer) {
-        // A "case" is analog to a particular branch in switch-case over the
-        // index. Given the variant type `T` known statically, we create a
-        // closure that will deserialize a value `T` and return it as a variant.
-        using Case = std::function<std::variant<Types...>(Deserializer &)>;
-        auto make_case = [](auto tag) -> Case {
-            // Obtain the type `T` encoded in the type of `tag ==
-            // std::common_type<T>{}`.
-            using T = typename decltype(tag)::type;
-            auto f = [](Deserializer &de) {
-                return std::variant<Types...>(
-                    Deserializable<T>::deserialize(de));
-            };
-            return f;
+        // Read the variant index and dispatch to the corresponding case.
+        auto index = deserializer.deserialize_variant_index();
+        if (index >= sizeof...(Types)) {
+            deserializer.fail("Unknown variant index for enum");
+            // Errors are recorded: continue with any value.
+            index = 0;
+        }
+        return deserialize_case(deserializer, index,
+                                std::index_sequence_for<Types...>{});
+    }
+
+    // The current alternative is overwritten in place when the index
+    // matches. Otherwise, a new alternative is constructed.
+    template <typename Deserializer>
+    static void deserialize_into(std::variant<Types...> &value,
+                                 Deserializer &deserializer) {
+        auto index = deserializer.deserialize_variant_index();
+        if (index >= sizeof...(Types)) {
+            deserializer.fail("Unknown variant index for enum");
+            index = 0;
+        }
+        if (index == value.index()) {
+            deserialize_case_into(value, deserializer, index,
+                                  std::index_sequence_for<Types...>{});
+        } else {
+            value = deserialize_case(deserializer, index,
+                                     std::index_sequence_for<Types...>{});
+        }
+    }
+
+  private:
+    // A "case" is analog to a particular branch in switch-case over the
+    // index. The table of cases is a constant array of function pointers,
+    // which requires no initialization at runtime.
+    template <typename Deserializer, size_t... Indices>
+    static std::variant<Types...>
+    deserialize_case(Deserializer &deserializer, size_t index,
+                     std::index_sequence<Indices...>) {
+        using Case = std::variant<Types...> (*)(Deserializer &);
+        static constexpr Case cases[] = {
+            &deserialize_alternative<Deserializer, Indices>...};
+        return cases[index](deserializer);
+    }
+
+    template <typename Deserializer, size_t Index>
+    static std::variant<Types...>
+    deserialize_alternative(Deserializer &deserializer) {
+        using T = std::variant_alternative_t<Index, std::variant<Types...>>;
+        return std::variant<Types...>(
+            std::in_place_index<Index>,
+            Deserializable<T>::deserialize(deserializer));
+    }
+
+    template <typename Deserializer, size_t... Indices>
+    static void deserialize_case_into(std::variant<Types...> &value,
+                                      Deserializer &deserializer, size_t index,
+                                      std::index_sequence<Indices...>) {
+        using Case = void (*)(std::variant<Types...> &, Deserializer &);
+        static constexpr Case cases[] = {
+            &deserialize_alternative_into<Deserializer, Indices>...};
+        cases[index](value, deserializer);
+    }
+
+    template <typename Deserializer, size_t Index>
+    static void deserialize_alternative_into(std::variant<Types...> &value,
+                                             Deserializer &deserializer) {
+        serde::deserialize_into(*std::get_if<Index>(&value), deserializer);
+    }
+};
+
+// --- Implementation of EncodedSizeBounds for base types ---
+
+template <size_t Size>
+struct FixedEncodedSizeBounds {
+    template <typename Encoding>
+    static constexpr SizeBounds bounds() {
+        return {Size, Size};
+    }
+};
+
+template <>
+struct EncodedSizeBounds<std::monostate> : FixedEncodedSizeBounds<0> {};
+template <>
+struct EncodedSizeBounds<bool> : FixedEncodedSizeBounds<1> {};
+// Encodings without floats (e.g. BCS) fail to serialize them: their size is
+// unknown, so that `serialized_size` fails too.
+template <size_t Size>
+struct FloatEncodedSizeBounds {
+    template <typename Encoding>
+    static constexpr SizeBounds bounds() {
+        if constexpr (Encoding::has_floats) {
+            return {Size, Size};
+        } else {
+            return {0, SIZE_MAX};
+        }
+    }
+};
+
+template <>
+struct EncodedSizeBounds<float> : FloatEncodedSizeBounds<4> {};
+template <>
+struct EncodedSizeBounds<double> : FloatEncodedSizeBounds<8> {};
+template <>
+struct EncodedSizeBounds<uint8_t> : FixedEncodedSizeBounds<1> {};
+template <>
+struct EncodedSizeBounds<uint16_t> : FixedEncodedSizeBounds<2> {};
+template <>
+struct EncodedSizeBounds<uint32_t> : FixedEncodedSizeBounds<4> {};
+template <>
+struct EncodedSizeBounds<uint64_t> : FixedEncodedSizeBounds<8> {};
+template <>
+struct EncodedSizeBounds<uint128_t> : FixedEncodedSizeBounds<16> {};
+template <>
+struct EncodedSizeBounds<int8_t> : FixedEncodedSizeBounds<1> {};
+template <>
+struct EncodedSizeBounds<int16_t> : FixedEncodedSizeBounds<2> {};
+template <>
+struct EncodedSizeBounds<int32_t> : FixedEncodedSizeBounds<4> {};
+template <>
+struct EncodedSizeBounds<int64_t> : FixedEncodedSizeBounds<8> {};
+template <>
+struct EncodedSizeBounds<int128_t> : FixedEncodedSizeBounds<16> {};
+#ifdef SERDE_HAS_INT128
+template <>
+struct EncodedSizeBounds<native_uint128_t> : FixedEncodedSizeBounds<16> {};
+template <>
+struct EncodedSizeBounds<native_int128_t> : FixedEncodedSizeBounds<16> {};
+#endif
+
+// UTF-8 encoding of a single code point.
+template <>
+struct EncodedSizeBounds<char32_t> {
+    template <typename Encoding>
+    static constexpr SizeBounds bounds() {
+        return {1, 4};
+    }
+};
+
+template <typename Allocator>
+struct EncodedSizeBounds<
+    std::basic_string<char, std::char_traits<char>, Allocator>> {
+    template <typename Encoding>
+    static constexpr SizeBounds bounds() {
+        return {Encoding::len.min, SIZE_MAX};
+    }
+};
+
+// --- Derivation of EncodedSizeBounds for composite types ---
+
+// Value pointers are only used for recursive types. Do not look inside to
+// avoid infinite recursion.
+template <typename T, typename Allocator>
+struct EncodedSizeBounds<value_ptr<T, Allocator>> {
+    template <typename Encoding>
+    static constexpr SizeBounds bounds() {
+        return {0, SIZE_MAX};
+    }
+};
+
+template <typename T>
+struct EncodedSizeBounds<std::optional<T>> {
+    template <typename Encoding>
+    static constexpr SizeBounds bounds() {
+        return SizeBounds{1, 1} +
+               (SizeBounds{0, 0} | encoded_size_bounds<T, Encoding>);
+    }
+};
+
+template <typename T, typename Allocator>
+struct EncodedSizeBounds<std::vector<T, Allocator>> {
+    template <typename Encoding>
+    static constexpr SizeBounds bounds() {
+        return {Encoding::len.min, SIZE_MAX};
+    }
+};
+
+template <typename T, std::size_t N>
+struct EncodedSizeBounds<std::array<T, N>> {
+    template <typename Encoding>
+    static constexpr SizeBounds bounds() {
+        return encoded_size_bounds<T, Encoding> * N;
+    }
+};
+
+template <typename K, typename V, typename Compare, typename Allocator>
+struct EncodedSizeBounds<std::map<K, V, Compare, Allocator>> {
+    template <typename Encoding>
+    static constexpr SizeBounds bounds() {
+        return {Encoding::len.min, SIZE_MAX};
+    }
+};
+
+template <class... Types>
+struct EncodedSizeBounds<std::tuple<Types...>> {
+    template <typename Encoding>
+    static constexpr SizeBounds bounds() {
+        return (SizeBounds{0, 0} + ... +
+                encoded_size_bounds<Types, Encoding>);
+    }
+};
+
+template <class T, class... Types>
+struct EncodedSizeBounds<std::variant<T, Types...>> {
+    template <typename Encoding>
+    static constexpr SizeBounds bounds() {
+        return Encoding::variant_index +
+               (encoded_size_bounds<T, Encoding> | ... |
+                encoded_size_bounds<Types, Encoding>);
+    }
+};
+
+// --- Implementation of EncodedOrder for base types ---
+
+struct MatchingEncodedOrder {
+    template <typename Encoding>
+    static constexpr bool matches_less() {
+        return true;
+    }
+};
+
+template <>
+struct EncodedOrder<std::monostate> : MatchingEncodedOrder {};
+template <>
+struct EncodedOrder<bool> : MatchingEncodedOrder {};
+template <>
+struct EncodedOrder<uint8_t> : MatchingEncodedOrder {};
+
+// --- Derivation of EncodedOrder for composite types ---
+
+// Encodings of distinct values of the same type are never a prefix of one
+// another, therefore comparing the encodings of components in sequence is the
+// same as comparing the concatenated encodings.
+
+// `std::nullopt` is the smallest value and uses the smallest tag.
+template <typename T>
+struct EncodedOrder<std::optional<T>> {
+    template <typename Encoding>
+    static constexpr bool matches_less() {
+        return encoded_order_matches_less<T, Encoding>;
+    }
+};
+
+template <typename T, std::size_t N>
+struct EncodedOrder<std::array<T, N>> {
+    template <typename Encoding>
+    static constexpr bool matches_less() {
+        return encoded_order_matches_less<T, Encoding>;
+    }
+};
+
+template <class... Types>
+struct EncodedOrder<std::tuple<Types...>> {
+    template <typename Encoding>
+    static constexpr bool matches_less() {
+        return (true && ... && encoded_order_matches_less<Types, Encoding>);
+    }
+};
+
+// Only the first variant indices have encodings that sort like the indices
+// themselves.
+template <class... Types>
+struct EncodedOrder<std::variant<Types...>> {
+    template <typename Encoding>
+    static constexpr bool matches_less() {
+        return sizeof...(Types) <= Encoding::ordered_variant_count &&
+               (true && ... && encoded_order_matches_less<Types, Encoding>);
+    }
+};
+
+// --- Implementation of EncodedComparison for base types ---
+
+template <typename T>
+int three_way_compare(const T &lhs, const T &rhs) {
+    return lhs < rhs ? -1 : (rhs < lhs ? 1 : 0);
+}
+
+// Compare the ULEB128 encodings of lengths and variant indices.
+inline int compare_uleb128(uint64_t lhs, uint64_t rhs) {
+    while (lhs != rhs) {
+        uint8_t lhs_byte = (lhs & 0x7f) | (lhs > 0x7f ? 0x80 : 0);
+        uint8_t rhs_byte = (rhs & 0x7f) | (rhs > 0x7f ? 0x80 : 0);
+        if (lhs_byte != rhs_byte) {
+            return lhs_byte < rhs_byte ? -1 : 1;
+        }
+        lhs >>= 7;
+        rhs >>= 7;
+    }
+    return 0;
+}
+
+inline int compare_bytes(const uint8_t *lhs, const uint8_t *rhs, size_t len) {
+    int order = len == 0 ? 0 : std::memcmp(lhs, rhs, len);
+    return order < 0 ? -1 : (order > 0 ? 1 : 0);
+}
+
+// Integers and floating-point numbers are encoded as little-endian bytes.
+template <typename T>
+struct LittleEndianComparison {
+    static int compare(const T &lhs, const T &rhs) {
+        return three_way_compare(reverse_bytes(bits_of(lhs)),
+                                 reverse_bytes(bits_of(rhs)));
+    }
+
+  private:
+    using Bits = std::conditional_t<
+        sizeof(T) == 1, uint8_t,
+        std::conditional_t<
+            sizeof(T) == 2, uint16_t,
+            std::conditional_t<sizeof(T) == 4, uint32_t, uint64_t>>>;
+
+    static Bits bits_of(T value) {
+        Bits bits;
+        std::memcpy(&bits, &value, sizeof(T));
+        return bits;
+    }
+
+    static Bits reverse_bytes(Bits bits) {
+        Bits result = 0;
+        for (size_t i = 0; i < sizeof(Bits); i++) {
+            result = (Bits)(result << 8) | (bits & 0xff);
+            bits = (Bits)(bits >> 8);
+        }
+        return result;
+    }
+};
+
+template <>
+struct EncodedComparison<std::monostate> {
+    static int compare(const std::monostate &, const std::monostate &) {
+        return 0;
+    }
+};
+template <>
+struct EncodedComparison<bool> {
+    static int compare(const bool &lhs, const bool &rhs) {
+        return three_way_compare(lhs, rhs);
+    }
+};
+template <>
+struct EncodedComparison<float> : LittleEndianComparison<float> {};
+template <>
+struct EncodedComparison<double> : LittleEndianComparison<double> {};
+template <>
+struct EncodedComparison<uint8_t> : LittleEndianComparison<uint8_t> {};
+template <>
+struct EncodedComparison<uint16_t> : LittleEndianComparison<uint16_t> {};
+template <>
+struct EncodedComparison<uint32_t> : LittleEndianComparison<uint32_t> {};
+template <>
+struct EncodedComparison<uint64_t> : LittleEndianComparison<uint64_t> {};
+template <>
+struct EncodedComparison<int8_t> : LittleEndianComparison<int8_t> {};
+template <>
+struct EncodedComparison<int16_t> : LittleEndianComparison<int16_t> {};
+template <>
+struct EncodedComparison<int32_t> : LittleEndianComparison<int32_t> {};
+template <>
+struct EncodedComparison<int64_t> : LittleEndianComparison<int64_t> {};
+
+// The low half comes first in little-endian order.
+template <>
+struct EncodedComparison<uint128_t> {
+    static int compare(const uint128_t &lhs, const uint128_t &rhs) {
+        if (int order = compare_encodings(lhs.low, rhs.low)) {
+            return order;
+        }
+        return compare_encodings(lhs.high, rhs.high);
+    }
+};
+template <>
+struct EncodedComparison<int128_t> {
+    static int compare(const int128_t &lhs, const int128_t &rhs) {
+        if (int order = compare_encodings(lhs.low, rhs.low)) {
+            return order;
+        }
+        return compare_encodings(lhs.high, rhs.high);
+    }
+};
+#ifdef SERDE_HAS_INT128
+template <>
+struct EncodedComparison<native_uint128_t> {
+    static int compare(const native_uint128_t &lhs,
+                       const native_uint128_t &rhs) {
+        return compare_encodings(uint128_t(lhs), uint128_t(rhs));
+    }
+};
+template <>
+struct EncodedComparison<native_int128_t> {
+    static int compare(const native_int128_t &lhs, const native_int128_t &rhs) {
+        return compare_encodings(int128_t(lhs), int128_t(rhs));
+    }
+};
+#endif
+
+// UTF-8 encodings are ordered like code points.
+template <>
+struct EncodedComparison<char32_t> {
+    static int compare(const char32_t &lhs, const char32_t &rhs) {
+        return three_way_compare(lhs, rhs);
+    }
+};
+
+template <typename Allocator>
+struct EncodedComparison<
+    std::basic_string<char, std::char_traits<char>, Allocator>> {
+    using String = std::basic_string<char, std::char_traits<char>, Allocator>;
+
+    static int compare(const String &lhs, const String &rhs) {
+        if (int order = compare_uleb128(lhs.size(), rhs.size())) {
+            return order;
+        }
+        return compare_bytes((const uint8_t *)lhs.data(),
+                             (const uint8_t *)rhs.data(), lhs.size());
+    }
+};
+
+// --- Derivation of EncodedComparison for composite types ---
+
+template <typename T, typename Allocator>
+struct EncodedComparison<value_ptr<T, Allocator>> {
+    static int compare(const value_ptr<T, Allocator> &lhs,
+                       const value_ptr<T, Allocator> &rhs) {
+        return compare_encodings(*lhs, *rhs);
+    }
+};
+
+template <typename T>
+struct EncodedComparison<std::optional<T>> {
+    static int compare(const std::optional<T> &lhs,
+                       const std::optional<T> &rhs) {
+        if (!lhs.has_value() || !rhs.has_value()) {
+            return three_way_compare(lhs.has_value(), rhs.has_value());
+        }
+        return compare_encodings(*lhs, *rhs);
+    }
+};
+
+// Compare `len` elements in a row.
+template <typename T>
+int compare_elements(const T *lhs, const T *rhs, size_t len) {
+    if constexpr (std::is_same_v<T, uint8_t>) {
+        return compare_bytes(lhs, rhs, len);
+    } else {
+        for (size_t i = 0; i < len; i++) {
+            if (int order = compare_encodings(lhs[i], rhs[i])) {
+                return order;
+            }
+        }
+        return 0;
+    }
+}
+
+template <typename T, typename Allocator>
+struct EncodedComparison<std::vector<T, Allocator>> {
+    static int compare(const std::vector<T, Allocator> &lhs,
+                       const std::vector<T, Allocator> &rhs) {
+        if (int order = compare_uleb128(lhs.size(), rhs.size())) {
+            return order;
+        }
+        if constexpr (std::is_same_v<T, bool>) {
+            for (size_t i = 0; i < lhs.size(); i++) {
+                if (lhs[i] != rhs[i]) {
+                    return lhs[i] ? 1 : -1;
+                }
+            }
+            return 0;
+        } else {
+            return compare_elements(lhs.data(), rhs.data(), lhs.size());
+        }
+    }
+};
+
+template <typename T, std::size_t N>
+struct EncodedComparison<std::array<T, N>> {
+    static int compare(const std::array<T, N> &lhs,
+                       const std::array<T, N> &rhs) {
+        return compare_elements(lhs.data(), rhs.data(), N);
+    }
+};
+
+// Map entries are compared in canonical order, that is, sorted by the
+// encodings of their keys.
+template <typename K, typename V, typename Compare, typename Allocator>
+struct EncodedComparison<std::map<K, V, Compare, Allocator>> {
+    using Map = std::map<K, V, Compare, Allocator>;
+
+    static int compare(const Map &lhs, const Map &rhs) {
+        if (int order = compare_uleb128(lhs.size(), rhs.size())) {
+            return order;
+        }
+        auto lhs_entries = canonical_entries(lhs);
+        auto rhs_entries = canonical_entries(rhs);
+        for (size_t i = 0; i < lhs_entries.size(); i++) {
+            const auto &lhs_entry = *lhs_entries[i];
+            const auto &rhs_entry = *rhs_entries[i];
+            if (int order =
+                    compare_encodings(lhs_entry.first, rhs_entry.first)) {
+                return order;
+            }
+            if (int order =
+                    compare_encodings(lhs_entry.second, rhs_entry.second)) {
+                return order;
+            }
+        }
+        return 0;
+    }
+
+  private:
+    static std::vector<const typename Map::value_type *>
+    canonical_entries(const Map &value) {
+        std::vector<const typename Map::value_type *> entries;
+        entries.reserve(value.size());
+        for (const auto &entry : value) {
+            entries.push_back(&entry);
+        }
+        auto is_less = [](const typename Map::value_type *entry1,
+                          const typename Map::value_type *entry2) {
+            return compare_encodings(entry1->first, entry2->first) < 0;
         };
+        if (!std::is_sorted(entries.begin(), entries.end(), is_less)) {
+            std::sort(entries.begin(), entries.end(), is_less);
+        }
+        return entries;
+    }
+};
 
-        // The static array of all the cases for this variant.
-        static const std::array<Case, sizeof...(Types)> cases = {
-            make_case(std::common_type<Types>{})...};
+template <class... Types>
+struct EncodedComparison<std::tuple<Types...>> {
+    static int compare(const std::tuple<Types...> &lhs,
+                       const std::tuple<Types...> &rhs) {
+        return compare_components(lhs, rhs,
+                                  std::index_sequence_for<Types...>{});
+    }
 
-        // Read the variant index and execute the corresponding case.
-        auto index = deserializer.deserialize_variant_index();
-        if (index > cases.size()) {
-            throw deserialization_error("Unknown variant index for enum");
+  private:
+    template <size_t... Indices>
+    static int compare_components(const std::tuple<Types...> &lhs,
+                                  const std::tuple<Types...> &rhs,
+                                  std::index_sequence<Indices...>) {
+        // Stop at the first component that differs. (The cast avoids an
+        // unused-value warning for the empty tuple, where the fold is `true`.)
+        int order = 0;
+        (void)(((order = compare_encodings(std::get<Indices>(lhs),
+                                           std::get<Indices>(rhs))) == 0) &&
+               ...);
+        return order;
+    }
+};
+
+template <class... Types>
+struct EncodedComparison<std::variant<Types...>> {
+    static int compare(const std::variant<Types...> &lhs,
+                       const std::variant<Types...> &rhs) {
+        if (lhs.valueless_by_exception() || rhs.valueless_by_exception()) {
+            return three_way_compare(!lhs.valueless_by_exception(),
+                                     !rhs.valueless_by_exception());
         }
-        return cases.at(index)(deserializer);
+        if (int order = compare_uleb128(lhs.index(), rhs.index())) {
+            return order;
+        }
+        // Dispatch to the inner type with a table of function pointers.
+        return compare_case(lhs, rhs, std::index_sequence_for<Types...>{});
+    }
+
+  private:
+    template <size_t... Indices>
+    static int compare_case(const std::variant<Types...> &lhs,
+                            const std::variant<Types...> &rhs,
+                            std::index_sequence<Indices...>) {
+        using Case = int (*)(const std::variant<Types...> &,
+                             const std::variant<Types...> &);
+        static constexpr Case cases[] = {&compare_alternative<Indices>...};
+        return cases[lhs.index()](lhs, rhs);
+    }
+
+    template <size_t Index>
+    static int compare_alternative(const std::variant<Types...> &lhs,
+                                   const std::variant<Types...> &rhs) {
+        return compare_encodings(*std::get_if<Index>(&lhs),
+                                 *std::get_if<Index>(&rhs));
+    }
+};
+
+// Types ordered by `compare_encodings`, such as generated types.
+struct ComparedEncodedOrder {
+    template <typename Encoding>
+    static constexpr bool matches_less() {
+        return Encoding::is_ordered_by_compare_encodings;
+    }
+};
+
+// --- Implementation of Hashable ---
+
+template <>
+struct Hashable<uint128_t> {
+    static size_t hash(const uint128_t &value) {
+        return hash_combine(hash_value(value.high), hash_value(value.low));
+    }
+};
+
+template <>
+struct Hashable<int128_t> {
+    static size_t hash(const int128_t &value) {
+        return hash_combine(hash_value(value.high), hash_value(value.low));
+    }
+};
+
+// Native integers hash like the structs.
+#ifdef SERDE_HAS_INT128
+template <>
+struct Hashable<native_uint128_t> {
+    static size_t hash(const native_uint128_t &value) {
+        return hash_value(uint128_t(value));
+    }
+};
+
+template <>
+struct Hashable<native_int128_t> {
+    static size_t hash(const native_int128_t &value) {
+        return hash_value(int128_t(value));
+    }
+};
+#endif
+
+template <typename T, typename Allocator>
+struct Hashable<value_ptr<T, Allocator>> {
+    static size_t hash(const value_ptr<T, Allocator> &value) {
+        return hash_value(*value);
+    }
+};
+
+template <typename T>
+struct Hashable<std::optional<T>> {
+    static size_t hash(const std::optional<T> &value) {
+        if (!value.has_value()) {
+            return 0;
+        }
+        return hash_combine(1, hash_value(*value));
+    }
+};
+
+// Hash `len` elements in a row. Integers are hashed as a single block of
+// memory.
+template <typename T>
+size_t hash_elements(size_t seed, const T *data, size_t len) {
+    if constexpr (std::is_integral_v<T> && !std::is_same_v<T, bool>) {
+        std::string_view bytes((const char *)data, len * sizeof(T));
+        return hash_combine(seed, std::hash<std::string_view>{}(bytes));
+    } else {
+        for (size_t i = 0; i < len; i++) {
+            seed = hash_combine(seed, hash_value(data[i]));
+        }
+        return seed;
+    }
+}
+
+template <typename T, typename Allocator>
+struct Hashable<std::vector<T, Allocator>> {
+    static size_t hash(const std::vector<T, Allocator> &value) {
+        if constexpr (std::is_same_v<T, bool>) {
+            return std::hash<std::vector<bool, Allocator>>{}(value);
+        } else {
+            return hash_elements(value.size(), value.data(), value.size());
+        }
+    }
+};
+
+template <typename T, std::size_t N>
+struct Hashable<std::array<T, N>> {
+    static size_t hash(const std::array<T, N> &value) {
+        return hash_elements(N, value.data(), N);
+    }
+};
+
+template <typename K, typename V, typename Compare, typename Allocator>
+struct Hashable<std::map<K, V, Compare, Allocator>> {
+    static size_t hash(const std::map<K, V, Compare, Allocator> &value) {
+        size_t seed = value.size();
+        for (const auto &item : value) {
+            seed = hash_combine(seed, hash_value(item.first));
+            seed = hash_combine(seed, hash_value(item.second));
+        }
+        return seed;
+    }
+};
+
+template <class... Types>
+struct Hashable<std::tuple<Types...>> {
+    static size_t hash(const std::tuple<Types...> &value) {
+        return std::apply(
+            [](Types const &... args) {
+                size_t seed = 0;
+                ((seed = hash_combine(seed, hash_value(args))), ...);
+                return seed;
+            },
+            value);
+    }
+};
+
+template <class... Types>
+struct Hashable<std::variant<Types...>> {
+    static size_t hash(const std::variant<Types...> &value) {
+        auto index = value.index();
+        if (index == std::variant_npos) {
+            return 0;
+        }
+        // Dispatch to the inner type with a table of function pointers.
+        return hash_combine(
+            index,
+            hash_case(value, index, std::index_sequence_for<Types...>{}));
+    }
+
+  private:
+    template <size_t... Indices>
+    static size_t hash_case(const std::variant<Types...> &value, size_t index,
+                            std::index_sequence<Indices...>) {
+        using Case = size_t (*)(const std::variant<Types...> &);
+        static constexpr Case cases[] = {&hash_alternative<Indices>...};
+        return cases[index](value);
+    }
+
+    template <size_t Index>
+    static size_t hash_alternative(const std::variant<Types...> &value) {
+        return hash_value(*std::get_if<Index>(&value));
     }
 };
 
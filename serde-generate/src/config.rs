@@ -13,6 +13,8 @@ pub struct CodeGeneratorConfig {
     pub(crate) comments: DocComments,
     pub(crate) custom_code: CustomCode,
     pub(crate) c_style_enums: bool,
+    pub(crate) native_128bit_integers: bool,
+    pub(crate) polymorphic_allocators: bool,
 }
 
 #[derive(Clone, Copy, Debug, PartialOrd, Ord, PartialEq, Eq)]
@@ -67,6 +69,8 @@ impl CodeGeneratorConfig {
             comments: BTreeMap::new(),
             custom_code: BTreeMap::new(),
             c_style_enums: false,
+            native_128bit_integers: false,
+            polymorphic_allocators: false,
         }
     }
 
@@ -90,6 +94,10 @@ impl CodeGeneratorConfig {
     }
 
     /// Container names provided by external modules.
+    ///
+    /// In C++, generated types are ordered by their BCS encodings using `serde::EncodedComparison`.
+    /// External types should specialize this trait, otherwise they are compared by serializing
+    /// them, which requires `bcs.hpp`.
     pub fn with_external_definitions(mut self, external_definitions: ExternalDefinitions) -> Self {
         self.external_definitions = external_definitions;
         self
@@ -117,6 +125,25 @@ impl CodeGeneratorConfig {
         self.c_style_enums = c_style_enums;
         self
     }
+
+    /// Represent 128-bit integers with the native types of the target language
+    /// (e.g. `unsigned __int128` in C++) when available, in supported languages.
+    pub fn with_native_128bit_integers(mut self, native_128bit_integers: bool) -> Self {
+        self.native_128bit_integers = native_128bit_integers;
+        self
+    }
+
+    /// Use containers with polymorphic allocators (e.g. `std::pmr` in C++), so that
+    /// deserialized values can be allocated from a custom memory resource (e.g. an arena),
+    /// in supported languages.
+    ///
+    /// In C++, the fields of types with custom code are assigned after default construction,
+    /// because custom code may declare constructors. These fields may then use the default
+    /// memory resource.
+    pub fn with_polymorphic_allocators(mut self, polymorphic_allocators: bool) -> Self {
+        self.polymorphic_allocators = polymorphic_allocators;
+        self
+    }
 }
 
 impl Encoding {
@@ -9,7 +9,7 @@ use crate::{
 use heck::CamelCase;
 use serde_reflection::{ContainerFormat, Format, Named, Registry, VariantFormat};
 use std::{
-    collections::{BTreeMap, HashMap, HashSet},
+    collections::{BTreeMap, BTreeSet, HashMap, HashSet},
     io::{Result, Write},
     path::PathBuf,
 };
@@ -35,6 +35,26 @@ struct CppEmitter<'a, T> {
     known_sizes: HashSet<&'a str>,
     /// Current namespace (e.g. vec!["name", "MyClass"])
     current_namespace: Vec<String>,
+    /// Maximum number of nested containers in the values of each type, for the types where it is
+    /// statically bounded. (Used to skip tracking the container depth.)
+    container_depths: HashMap<String, usize>,
+    /// Types with a bounded depth that are used directly by types without one. (Used to check the
+    /// remaining depth budget once for all the nested containers of their values.)
+    depth_checked_containers: HashSet<String>,
+    /// Types that do not depend on external definitions. (Used to specialize `std::hash`.)
+    hashable_containers: HashSet<String>,
+}
+
+/// How the generated code checks the depth of nested containers for a given type.
+#[derive(Clone, Copy)]
+enum DepthTracking {
+    /// Not a container (e.g. the variants of an enum).
+    None,
+    /// Always track the depth (e.g. recursive types).
+    Always,
+    /// Values nest at most this many containers: check once that the remaining budget is
+    /// sufficient, then skip tracking the depth of their nested containers.
+    Bounded(usize),
 }
 
 impl<'a> CodeGenerator<'a> {
@@ -73,6 +93,9 @@ impl<'a> CodeGenerator<'a> {
             known_names: HashSet::new(),
             known_sizes: HashSet::new(),
             current_namespace,
+            container_depths: HashMap::new(),
+            depth_checked_containers: HashSet::new(),
+            hashable_containers: HashSet::new(),
         };
 
         emitter.output_preamble()?;
@@ -80,6 +103,54 @@ impl<'a> CodeGenerator<'a> {
 
         let dependencies = analyzer::get_dependency_map(registry)?;
         let entries = analyzer::best_effort_topological_sort(&dependencies);
+        // External definitions are not generated: their depth is unknown.
+        let mut depths: HashMap<_, _> = self
+            .external_qualified_names
+            .keys()
+            .map(|name| (name.as_str(), None))
+            .collect();
+        for name in dependencies.keys() {
+            if let Some(depth) =
+                get_container_depth(name, &dependencies, &mut depths, &mut BTreeSet::new())
+            {
+                // Deserializers start with a budget of `MAX_CONTAINER_DEPTH` at the entry point.
+                // Deeper types are tracked like recursive ones.
+                if depth <= MAX_CONTAINER_DEPTH {
+                    emitter.container_depths.insert(name.to_string(), depth);
+                }
+            }
+        }
+        for (name, children) in &dependencies {
+            if !emitter.container_depths.contains_key(*name) {
+                for child in children {
+                    if emitter.container_depths.contains_key(*child) {
+                        emitter.depth_checked_containers.insert(child.to_string());
+                    }
+                }
+            }
+        }
+        // The hash of external definitions may not be defined.
+        let mut unhashable: HashSet<_> = self
+            .external_qualified_names
+            .keys()
+            .map(String::as_str)
+            .collect();
+        loop {
+            let count = unhashable.len();
+            for (name, children) in &dependencies {
+                if children.iter().any(|child| unhashable.contains(child)) {
+                    unhashable.insert(*name);
+                }
+            }
+            if unhashable.len() == count {
+                break;
+            }
+        }
+        emitter.hashable_containers = dependencies
+            .keys()
+            .filter(|name| !unhashable.contains(*name))
+            .map(|name| name.to_string())
+            .collect();
 
         for name in entries {
             for dependency in &dependencies[name] {
@@ -96,6 +167,9 @@ impl<'a> CodeGenerator<'a> {
 
         emitter.output_close_namespace()?;
         writeln!(emitter.out)?;
+        for (name, format) in registry {
+            emitter.output_container_trait_declarations(name, format)?;
+        }
         for (name, format) in registry {
             emitter.output_container_traits(name, format)?;
         }
@@ -103,6 +177,40 @@ impl<'a> CodeGenerator<'a> {
     }
 }
 
+/// Same as `serde::BCS_MAX_CONTAINER_DEPTH` in the C++ runtime. Other encodings do not limit the
+/// depth.
+const MAX_CONTAINER_DEPTH: usize = 500;
+
+/// Compute the maximum number of nested containers in the values of the type `name`, or `None`
+/// if the type is recursive or depends on types outside of the registry (e.g. external
+/// definitions). Results are memoized in `depths`. `visiting` contains the types being visited.
+fn get_container_depth<'b>(
+    name: &'b str,
+    dependencies: &BTreeMap<&'b str, BTreeSet<&'b str>>,
+    depths: &mut HashMap<&'b str, Option<usize>>,
+    visiting: &mut BTreeSet<&'b str>,
+) -> Option<usize> {
+    if let Some(depth) = depths.get(name) {
+        return *depth;
+    }
+    let children = dependencies.get(name)?;
+    if !visiting.insert(name) {
+        // Recursive type.
+        return None;
+    }
+    let mut depth = Some(1);
+    for child in children {
+        let child_depth = get_container_depth(child, dependencies, depths, visiting);
+        depth = match (depth, child_depth) {
+            (Some(depth), Some(child_depth)) => Some(std::cmp::max(depth, child_depth + 1)),
+            _ => None,
+        };
+    }
+    visiting.remove(name);
+    depths.insert(name, depth);
+    depth
+}
+
 impl<'a, T> CppEmitter<'a, T>
 where
     T: std::io::Write,
@@ -174,6 +282,12 @@ where
         Ok(())
     }
 
+    /// Whether custom code is attached to the type with the fully qualified name `name`.
+    fn has_custom_code(&self, name: &str) -> bool {
+        let path: Vec<_> = name.split("::").map(String::from).collect();
+        self.generator.config.custom_code.contains_key(&path)
+    }
+
     /// Compute a fully qualified reference to the container type `name`.
     fn quote_qualified_name(&self, name: &str) -> String {
         self.generator
@@ -191,7 +305,7 @@ where
                 if require_known_size && !self.known_sizes.contains(x.as_str()) {
                     // Cannot use unique_ptr because we need a copy constructor (e.g. for vectors)
                     // and in-depth equality.
-                    format!("serde::value_ptr<{}>", qname)
+                    format!("serde::{}value_ptr<{}>", self.pmr_prefix(), qname)
                 } else {
                     qname
                 }
@@ -202,25 +316,42 @@ where
             I16 => "int16_t".into(),
             I32 => "int32_t".into(),
             I64 => "int64_t".into(),
-            I128 => "serde::int128_t".into(),
+            I128 => {
+                if self.generator.config.native_128bit_integers {
+                    "serde::native_int128_t".into()
+                } else {
+                    "serde::int128_t".into()
+                }
+            }
             U8 => "uint8_t".into(),
             U16 => "uint16_t".into(),
             U32 => "uint32_t".into(),
             U64 => "uint64_t".into(),
-            U128 => "serde::uint128_t".into(),
+            U128 => {
+                if self.generator.config.native_128bit_integers {
+                    "serde::native_uint128_t".into()
+                } else {
+                    "serde::uint128_t".into()
+                }
+            }
             F32 => "float".into(),
             F64 => "double".into(),
             Char => "char32_t".into(),
-            Str => "std::string".into(),
-            Bytes => "std::vector<uint8_t>".into(),
+            Str => format!("std::{}string", self.pmr_prefix()),
+            Bytes => format!("std::{}vector<uint8_t>", self.pmr_prefix()),
 
             Option(format) => format!(
                 "std::optional<{}>",
                 self.quote_type(format, require_known_size)
             ),
-            Seq(format) => format!("std::vector<{}>", self.quote_type(format, false)),
+            Seq(format) => format!(
+                "std::{}vector<{}>",
+                self.pmr_prefix(),
+                self.quote_type(format, false)
+            ),
             Map { key, value } => format!(
-                "std::map<{}, {}>",
+                "std::{}map<{}, {}>",
+                self.pmr_prefix(),
                 self.quote_type(key, false),
                 self.quote_type(value, false)
             ),
@@ -238,6 +369,15 @@ where
         }
     }
 
+    // Namespace of the containers using polymorphic allocators, if configured.
+    fn pmr_prefix(&self) -> &'static str {
+        if self.generator.config.polymorphic_allocators {
+            "pmr::"
+        } else {
+            ""
+        }
+    }
+
     fn quote_types(&self, formats: &[Format], require_known_size: bool) -> String {
         formats
             .iter()
@@ -330,6 +470,11 @@ where
             "friend bool operator==(const {}&, const {}&);",
             name, name
         )?;
+        writeln!(
+            self.out,
+            "friend bool operator<(const {}&, const {}&);",
+            name, name
+        )?;
         if self.generator.config.serialization {
             for encoding in &self.generator.config.encodings {
                 writeln!(
@@ -339,10 +484,60 @@ where
                 )?;
                 writeln!(
                     self.out,
-                    "static {} {}Deserialize(std::vector<uint8_t>);",
+                    "void {}SerializeInto(std::vector<uint8_t> &) const;",
+                    encoding.name()
+                )?;
+                writeln!(
+                    self.out,
+                    "size_t {}SerializedSize() const;",
+                    encoding.name()
+                )?;
+                writeln!(
+                    self.out,
+                    "static {0} {1}Deserialize(const uint8_t *, size_t);",
+                    name,
+                    encoding.name()
+                )?;
+                writeln!(
+                    self.out,
+                    "static {0} {1}Deserialize(const std::vector<uint8_t> &);",
+                    name,
+                    encoding.name()
+                )?;
+                writeln!(
+                    self.out,
+                    "static {0} {1}Deserialize(std::vector<uint8_t> &&);",
+                    name,
+                    encoding.name()
+                )?;
+                writeln!(
+                    self.out,
+                    "#ifdef SERDE_HAS_SPAN\nstatic {0} {1}Deserialize(std::span<const uint8_t>);\n#endif",
                     name,
                     encoding.name()
                 )?;
+                writeln!(
+                    self.out,
+                    "static serde::deserialization_result<{0}> {1}TryDeserialize(const uint8_t *, size_t);",
+                    name,
+                    encoding.name()
+                )?;
+                writeln!(
+                    self.out,
+                    "static serde::deserialization_result<{0}> {1}TryDeserialize(const std::vector<uint8_t> &);",
+                    name,
+                    encoding.name()
+                )?;
+                writeln!(
+                    self.out,
+                    "void {}DeserializeInto(const uint8_t *, size_t);",
+                    encoding.name()
+                )?;
+                writeln!(
+                    self.out,
+                    "void {}DeserializeInto(const std::vector<uint8_t> &);",
+                    encoding.name()
+                )?;
             }
         }
         Ok(())
@@ -388,6 +583,17 @@ where
         writeln!(self.out, "}}")
     }
 
+    fn output_struct_less_than_test(&mut self, name: &str) -> Result<()> {
+        writeln!(
+            self.out,
+            r#"
+inline bool operator<(const {0} &lhs, const {0} &rhs) {{
+    return serde::compare_encodings(lhs, rhs) < 0;
+}}"#,
+            name,
+        )
+    }
+
     fn output_struct_serialize_for_encoding(
         &mut self,
         name: &str,
@@ -396,15 +602,22 @@ where
         writeln!(
             self.out,
             r#"
-inline std::vector<uint8_t> {}::{}Serialize() const {{
-    auto serializer = serde::{}Serializer();
-    serde::Serializable<{}>::serialize(*this, serializer);
+inline std::vector<uint8_t> {0}::{1}Serialize() const {{
+    auto serializer = serde::{2}Serializer();
+    serde::Serializable<{0}>::serialize(*this, serializer);
     return std::move(serializer).bytes();
+}}
+
+inline void {0}::{1}SerializeInto(std::vector<uint8_t> &output) const {{
+    serde::serialize_into<serde::{2}Serializer>(*this, output);
+}}
+
+inline size_t {0}::{1}SerializedSize() const {{
+    return serde::serialized_size<serde::Basic{2}Serializer<serde::CountingSink>>(*this);
 }}"#,
             name,
             encoding.name(),
             encoding.name().to_camel_case(),
-            name
         )
     }
 
@@ -416,19 +629,58 @@ inline std::vector<uint8_t> {}::{}Serialize() const {{
         writeln!(
             self.out,
             r#"
-inline {} {}::{}Deserialize(std::vector<uint8_t> input) {{
-    auto deserializer = serde::{}Deserializer(input);
-    auto value = serde::Deserializable<{}>::deserialize(deserializer);
-    if (deserializer.get_buffer_offset() < input.size()) {{
-        throw serde::deserialization_error("Some input bytes were not read");
+inline {0} {0}::{1}Deserialize(const uint8_t *input, size_t size) {{
+    auto deserializer = serde::{2}Deserializer(input, size);
+    auto value = serde::Deserializable<{0}>::deserialize(deserializer);
+    if (deserializer.get_buffer_offset() < size) {{
+        deserializer.fail("Some input bytes were not read");
     }}
     return value;
+}}
+
+inline {0} {0}::{1}Deserialize(const std::vector<uint8_t> &input) {{
+    return {1}Deserialize(input.data(), input.size());
+}}
+
+inline {0} {0}::{1}Deserialize(std::vector<uint8_t> &&input) {{
+    auto bytes = std::move(input);
+    return {1}Deserialize(bytes.data(), bytes.size());
+}}
+
+#ifdef SERDE_HAS_SPAN
+inline {0} {0}::{1}Deserialize(std::span<const uint8_t> input) {{
+    return {1}Deserialize(input.data(), input.size());
+}}
+#endif
+
+inline serde::deserialization_result<{0}> {0}::{1}TryDeserialize(const uint8_t *input, size_t size) {{
+    auto deserializer = serde::{2}Deserializer(input, size);
+    deserializer.record_errors();
+    auto value = serde::Deserializable<{0}>::deserialize(deserializer);
+    if (deserializer.get_buffer_offset() < size) {{
+        deserializer.fail("Some input bytes were not read");
+    }}
+    return deserializer.make_result(std::move(value));
+}}
+
+inline serde::deserialization_result<{0}> {0}::{1}TryDeserialize(const std::vector<uint8_t> &input) {{
+    return {1}TryDeserialize(input.data(), input.size());
+}}
+
+inline void {0}::{1}DeserializeInto(const uint8_t *input, size_t size) {{
+    auto deserializer = serde::{2}Deserializer(input, size);
+    serde::Deserializable<{0}>::deserialize_into(*this, deserializer);
+    if (deserializer.get_buffer_offset() < size) {{
+        deserializer.fail("Some input bytes were not read");
+    }}
+}}
+
+inline void {0}::{1}DeserializeInto(const std::vector<uint8_t> &input) {{
+    {1}DeserializeInto(input.data(), input.size());
 }}"#,
-            name,
             name,
             encoding.name(),
             encoding.name().to_camel_case(),
-            name,
         )
     }
 
@@ -436,7 +688,7 @@ inline {} {}::{}Deserialize(std::vector<uint8_t> input) {{
         &mut self,
         name: &str,
         fields: &[&str],
-        is_container: bool,
+        depth_tracking: DepthTracking,
     ) -> Result<()> {
         writeln!(
             self.out,
@@ -447,9 +699,7 @@ void serde::Serializable<{0}>::serialize(const {0} &obj, Serializer &serializer)
             name,
         )?;
         self.out.indent();
-        if is_container {
-            writeln!(self.out, "serializer.increase_container_depth();")?;
-        }
+        self.output_increase_container_depth("serializer", depth_tracking)?;
         for field in fields {
             writeln!(
                 self.out,
@@ -457,9 +707,7 @@ void serde::Serializable<{0}>::serialize(const {0} &obj, Serializer &serializer)
                 field,
             )?;
         }
-        if is_container {
-            writeln!(self.out, "serializer.decrease_container_depth();")?;
-        }
+        self.output_decrease_container_depth("serializer", depth_tracking)?;
         self.out.unindent();
         writeln!(self.out, "}}")
     }
@@ -468,7 +716,7 @@ void serde::Serializable<{0}>::serialize(const {0} &obj, Serializer &serializer)
         &mut self,
         name: &str,
         fields: &[&str],
-        is_container: bool,
+        depth_tracking: DepthTracking,
     ) -> Result<()> {
         writeln!(
             self.out,
@@ -479,21 +727,189 @@ template <typename Deserializer>
             name,
         )?;
         self.out.indent();
-        if is_container {
-            writeln!(self.out, "deserializer.increase_container_depth();")?;
+        self.output_increase_container_depth("deserializer", depth_tracking)?;
+        if fields.is_empty() {
+            writeln!(self.out, "{} obj;", name)?;
+        } else if self.generator.config.polymorphic_allocators && !self.has_custom_code(name) {
+            // Fields are initialized directly: assigning them would copy values into the
+            // default memory resource of default-constructed fields. (Custom code may declare
+            // constructors, which rule out aggregate initialization.)
+            writeln!(self.out, "{} obj{{", name)?;
+            self.out.indent();
+            for field in fields {
+                writeln!(
+                    self.out,
+                    "serde::Deserializable<decltype({0}::{1})>::deserialize(deserializer),",
+                    name, field,
+                )?;
+            }
+            self.out.unindent();
+            writeln!(self.out, "}};")?;
+        } else {
+            writeln!(self.out, "{} obj;", name)?;
+            for field in fields {
+                writeln!(
+                    self.out,
+                    "obj.{0} = serde::Deserializable<decltype(obj.{0})>::deserialize(deserializer);",
+                    field,
+                )?;
+            }
+        }
+        self.output_decrease_container_depth("deserializer", depth_tracking)?;
+        writeln!(self.out, "return obj;")?;
+        self.out.unindent();
+        writeln!(self.out, "}}")
+    }
+
+    fn output_struct_deserialize_into(
+        &mut self,
+        name: &str,
+        fields: &[&str],
+        depth_tracking: DepthTracking,
+    ) -> Result<()> {
+        writeln!(
+            self.out,
+            r#"
+template <>
+template <typename Deserializer>
+void serde::Deserializable<{0}>::deserialize_into({0} &obj, Deserializer &deserializer) {{"#,
+            name,
+        )?;
+        self.out.indent();
+        self.output_increase_container_depth("deserializer", depth_tracking)?;
+        for field in fields {
+            writeln!(
+                self.out,
+                "serde::deserialize_into(obj.{}, deserializer);",
+                field,
+            )?;
         }
-        writeln!(self.out, "{} obj;", name)?;
+        self.output_decrease_container_depth("deserializer", depth_tracking)?;
+        self.out.unindent();
+        writeln!(self.out, "}}")
+    }
+
+    // Types with bounded nesting check the remaining budget once, which covers all their nested
+    // containers. This is stricter than tracking the depth of each container only for values that
+    // start close to the limit and do not reach their maximum depth.
+    fn output_increase_container_depth(
+        &mut self,
+        var: &str,
+        depth_tracking: DepthTracking,
+    ) -> Result<()> {
+        match depth_tracking {
+            DepthTracking::None => Ok(()),
+            DepthTracking::Always => writeln!(self.out, "{}.increase_container_depth();", var),
+            DepthTracking::Bounded(depth) => {
+                writeln!(self.out, "{}.check_container_depth_budget({});", var, depth)
+            }
+        }
+    }
+
+    fn output_decrease_container_depth(
+        &mut self,
+        var: &str,
+        depth_tracking: DepthTracking,
+    ) -> Result<()> {
+        match depth_tracking {
+            DepthTracking::None | DepthTracking::Bounded(_) => Ok(()),
+            DepthTracking::Always => writeln!(self.out, "{}.decrease_container_depth();", var),
+        }
+    }
+
+    fn output_struct_encoded_size_bounds(&mut self, name: &str, fields: &[&str]) -> Result<()> {
+        writeln!(
+            self.out,
+            r#"
+template <>
+template <typename Encoding>
+constexpr serde::SizeBounds serde::EncodedSizeBounds<{0}>::bounds() {{"#,
+            name,
+        )?;
+        self.out.indent();
+        writeln!(self.out, "serde::SizeBounds bounds = {{0, 0}};")?;
+        for field in fields {
+            writeln!(
+                self.out,
+                "bounds = bounds + serde::encoded_size_bounds<decltype({0}::{1}), Encoding>;",
+                name, field,
+            )?;
+        }
+        writeln!(self.out, "return bounds;")?;
+        self.out.unindent();
+        writeln!(self.out, "}}")
+    }
+
+    fn output_struct_encoded_order(&mut self, name: &str) -> Result<()> {
+        writeln!(
+            self.out,
+            r#"
+template <>
+template <typename Encoding>
+constexpr bool serde::EncodedOrder<{0}>::matches_less() {{
+    return serde::ComparedEncodedOrder::matches_less<Encoding>();
+}}"#,
+            name,
+        )
+    }
+
+    fn output_struct_comparison_declaration(&mut self, name: &str) -> Result<()> {
+        writeln!(
+            self.out,
+            r#"
+template <>
+inline int serde::EncodedComparison<{0}>::compare(const {0} &, const {0} &);"#,
+            name,
+        )
+    }
+
+    fn output_struct_hash_declaration(&mut self, name: &str) -> Result<()> {
+        writeln!(self.out, "\ntemplate <>\nstruct std::hash<{}>;", name)
+    }
+
+    fn output_struct_hash(&mut self, name: &str, fields: &[&str]) -> Result<()> {
+        writeln!(
+            self.out,
+            r#"
+template <>
+struct std::hash<{0}> {{
+    size_t operator()(const {0} &value) const {{"#,
+            name,
+        )?;
+        self.out.indent();
+        self.out.indent();
+        writeln!(self.out, "size_t seed = 0;")?;
         for field in fields {
             writeln!(
                 self.out,
-                "obj.{0} = serde::Deserializable<decltype(obj.{0})>::deserialize(deserializer);",
+                "seed = serde::hash_combine(seed, serde::hash_value(value.{}));",
                 field,
             )?;
         }
-        if is_container {
-            writeln!(self.out, "deserializer.decrease_container_depth();")?;
+        writeln!(self.out, "return seed;")?;
+        self.out.unindent();
+        writeln!(self.out, "}}")?;
+        self.out.unindent();
+        writeln!(self.out, "}};")
+    }
+
+    fn output_struct_comparison(&mut self, name: &str, fields: &[&str]) -> Result<()> {
+        writeln!(
+            self.out,
+            r#"
+template <>
+inline int serde::EncodedComparison<{0}>::compare(const {0} &lhs, const {0} &rhs) {{"#,
+            name,
+        )?;
+        self.out.indent();
+        for field in fields {
+            writeln!(
+                self.out,
+                "if (int order = serde::compare_encodings(lhs.{0}, rhs.{0})) {{ return order; }}",
+                field,
+            )?;
         }
-        writeln!(self.out, "return obj;")?;
+        writeln!(self.out, "return 0;")?;
         self.out.unindent();
         writeln!(self.out, "}}")
     }
@@ -502,10 +918,12 @@ template <typename Deserializer>
         &mut self,
         name: &str,
         fields: &[&str],
-        is_container: bool,
+        depth_tracking: DepthTracking,
+        hashable: bool,
     ) -> Result<()> {
         self.output_open_namespace()?;
         self.output_struct_equality_test(name, fields)?;
+        self.output_struct_less_than_test(name)?;
         if self.generator.config.serialization {
             for encoding in &self.generator.config.encodings {
                 self.output_struct_serialize_for_encoding(name, *encoding)?;
@@ -514,9 +932,16 @@ template <typename Deserializer>
         }
         self.output_close_namespace()?;
         let namespaced_name = self.quote_qualified_name(name);
+        self.output_struct_comparison(&namespaced_name, fields)?;
+        if hashable {
+            self.output_struct_hash(&namespaced_name, fields)?;
+        }
         if self.generator.config.serialization {
-            self.output_struct_serializable(&namespaced_name, fields, is_container)?;
-            self.output_struct_deserializable(&namespaced_name, fields, is_container)?;
+            self.output_struct_serializable(&namespaced_name, fields, depth_tracking)?;
+            self.output_struct_deserializable(&namespaced_name, fields, depth_tracking)?;
+            self.output_struct_deserialize_into(&namespaced_name, fields, depth_tracking)?;
+            self.output_struct_encoded_size_bounds(&namespaced_name, fields)?;
+            self.output_struct_encoded_order(&namespaced_name)?;
         }
         Ok(())
     }
@@ -535,27 +960,66 @@ template <typename Deserializer>
         }
     }
 
+    // Comparisons and hashes of generated types may depend on each other, therefore all of them
+    // are declared before they are defined.
+    fn output_container_trait_declarations(
+        &mut self,
+        name: &str,
+        format: &ContainerFormat,
+    ) -> Result<()> {
+        let hashable = self.hashable_containers.contains(name);
+        let mut names = vec![self.quote_qualified_name(name)];
+        if let ContainerFormat::Enum(variants) = format {
+            for variant in variants.values() {
+                names.push(self.quote_qualified_name(&format!("{}::{}", name, variant.name)));
+            }
+        }
+        for name in names {
+            self.output_struct_comparison_declaration(&name)?;
+            if hashable {
+                self.output_struct_hash_declaration(&name)?;
+            }
+        }
+        Ok(())
+    }
+
     fn output_container_traits(&mut self, name: &str, format: &ContainerFormat) -> Result<()> {
         use ContainerFormat::*;
+        // Bounded types nested in other bounded types are covered by the check of the outermost
+        // one, or by the budget of the entry point.
+        let depth_tracking = match self.container_depths.get(name) {
+            Some(depth) if self.depth_checked_containers.contains(name) => {
+                DepthTracking::Bounded(*depth)
+            }
+            Some(_) => DepthTracking::None,
+            None => DepthTracking::Always,
+        };
+        let hashable = self.hashable_containers.contains(name);
         match format {
-            UnitStruct => self.output_struct_traits(name, &[], true),
-            NewTypeStruct(_format) => self.output_struct_traits(name, &["value"], true),
-            TupleStruct(_formats) => self.output_struct_traits(name, &["value"], true),
+            UnitStruct => self.output_struct_traits(name, &[], depth_tracking, hashable),
+            NewTypeStruct(_format) => {
+                self.output_struct_traits(name, &["value"], depth_tracking, hashable)
+            }
+            TupleStruct(_formats) => {
+                self.output_struct_traits(name, &["value"], depth_tracking, hashable)
+            }
             Struct(fields) => self.output_struct_traits(
                 name,
                 &fields
                     .iter()
                     .map(|field| field.name.as_str())
                     .collect::<Vec<_>>(),
-                true,
+                depth_tracking,
+                hashable,
             ),
             Enum(variants) => {
-                self.output_struct_traits(name, &["value"], true)?;
+                self.output_struct_traits(name, &["value"], depth_tracking, hashable)?;
                 for variant in variants.values() {
                     self.output_struct_traits(
                         &format!("{}::{}", name, variant.name),
                         &Self::get_variant_fields(&variant.value),
-                        false,
+                        DepthTracking::None,
+                        hashable,
                     )?;
                 }
                 Ok(())
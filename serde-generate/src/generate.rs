@@ -76,9 +76,25 @@ struct Options {
     /// if the target language and the generator code support them.
     #[structopt(long)]
     use_c_style_enums: bool,
+
+    /// Represent 128-bit integers with native types (e.g. `unsigned __int128` in C++),
+    /// if the target language and the generator code support them.
+    #[structopt(long)]
+    use_native_128bit_integers: bool,
+
+    /// Use containers with polymorphic allocators (e.g. `std::pmr` in C++),
+    /// if the target language and the generator code support them.
+    #[structopt(long)]
+    use_polymorphic_allocators: bool,
 }
 
-fn get_codegen_config<'a, I>(name: String, runtimes: I, c_style_enums: bool) -> CodeGeneratorConfig
+fn get_codegen_config<'a, I>(
+    name: String,
+    runtimes: I,
+    c_style_enums: bool,
+    native_128bit_integers: bool,
+    polymorphic_allocators: bool,
+) -> CodeGeneratorConfig
 where
     I: IntoIterator<Item = &'a Runtime>,
 {
@@ -97,6 +113,8 @@ where
     CodeGeneratorConfig::new(name)
         .with_encodings(encodings)
         .with_c_style_enums(c_style_enums)
+        .with_native_128bit_integers(native_128bit_integers)
+        .with_polymorphic_allocators(polymorphic_allocators)
 }
 
 fn main() {
@@ -122,7 +140,13 @@ fn main() {
     match options.target_source_dir {
         None => {
             if let Some((registry, name)) = named_registry_opt {
-                let config = get_codegen_config(name, &runtimes, options.use_c_style_enums);
+                let config = get_codegen_config(
+                    name,
+                    &runtimes,
+                    options.use_c_style_enums,
+                    options.use_native_128bit_integers,
+                    options.use_polymorphic_allocators,
+                );
 
                 let stdout = std::io::stdout();
                 let mut out = stdout.lock();
@@ -178,7 +202,13 @@ fn main() {
                 };
 
             if let Some((registry, name)) = named_registry_opt {
-                let config = get_codegen_config(name, &runtimes, options.use_c_style_enums);
+                let config = get_codegen_config(
+                    name,
+                    &runtimes,
+                    options.use_c_style_enums,
+                    options.use_native_128bit_integers,
+                    options.use_polymorphic_allocators,
+                );
                 installer.install_module(&config, &registry).unwrap();
             }
 
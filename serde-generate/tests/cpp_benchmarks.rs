@@ -0,0 +1,434 @@
+// Copyright (c) Facebook, Inc. and its affiliates
+// SPDX-License-Identifier: MIT OR Apache-2.0
+
+// Throughput benchmarks for the C++ runtime. These are ignored by default, run them with:
+// cargo test --release --test cpp_benchmarks -- --ignored --nocapture
+
+use heck::CamelCase;
+use serde_generate::{
+    cpp, test_utils,
+    test_utils::{Runtime, SerdeData},
+    CodeGeneratorConfig,
+};
+use std::{fs::File, io::Write, process::Command};
+use tempfile::tempdir;
+
+fn quote_bytes(bytes: &[u8]) -> String {
+    format!(
+        "std::vector<uint8_t>{{{}}}",
+        bytes
+            .iter()
+            .map(|x| format!("0x{:02x}", x))
+            .collect::<Vec<_>>()
+            .join(", ")
+    )
+}
+
+// Compile and run a C++ benchmark. The code in `body` is placed inside `main` and may use the
+// generated types (namespace `testing`), the vector `samples` containing the encodings of
+// `test_utils::get_sample_values`, and the helper `report`.
+fn run_cpp_benchmark(runtime: Runtime, body: &str) {
+    let registry = test_utils::get_registry().unwrap();
+    let dir = tempdir().unwrap();
+    let header_path = dir.path().join("test.hpp");
+    let mut header = File::create(&header_path).unwrap();
+
+    let config =
+        CodeGeneratorConfig::new("testing".to_string()).with_encodings(vec![runtime.into()]);
+    let generator = cpp::CodeGenerator::new(&config);
+    generator.output(&mut header, &registry).unwrap();
+
+    let samples: Vec<_> =
+        test_utils::get_sample_values(runtime.has_canonical_maps(), runtime.has_floats())
+            .iter()
+            .map(|value: &SerdeData| quote_bytes(&runtime.serialize(value)))
+            .collect();
+
+    let source_path = dir.path().join("bench.cpp");
+    let mut source = File::create(&source_path).unwrap();
+    writeln!(
+        source,
+        r#"
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include "test.hpp"
+
+using namespace testing;
+using Serializer = serde::{3}Serializer;
+using Deserializer = serde::{3}Deserializer;
+
+// Run `f` (which processes `bytes_per_iteration` bytes) repeatedly for about one second.
+template <typename F>
+void report(const char *name, size_t bytes_per_iteration, F f) {{
+    using clock = std::chrono::steady_clock;
+    size_t iterations = 0;
+    auto start = clock::now();
+    std::chrono::duration<double> elapsed{{0}};
+    while (elapsed.count() < 1.0) {{
+        for (int i = 0; i < 100; i++) {{
+            f();
+        }}
+        iterations += 100;
+        elapsed = clock::now() - start;
+    }}
+    double seconds = elapsed.count();
+    printf("{0} %-44s %10.1f MB/s %12.0f iterations/s\n", name,
+           (double)(bytes_per_iteration * iterations) / seconds / 1e6,
+           (double)iterations / seconds);
+}}
+
+int main() {{
+    std::vector<std::vector<uint8_t>> samples = {{{1}}};
+    size_t total_size = 0;
+    for (const auto &sample : samples) {{
+        total_size += sample.size();
+    }}
+    {2}
+    return 0;
+}}
+"#,
+        runtime.name(),
+        samples.join(", "),
+        body,
+        runtime.name().to_camel_case(),
+    )
+    .unwrap();
+
+    let status = Command::new("clang++")
+        .arg("--std=c++17")
+        .arg("-O3")
+        .arg("-DNDEBUG")
+        .arg("-o")
+        .arg(dir.path().join("bench"))
+        .arg("-I")
+        .arg("runtime/cpp")
+        .arg(source_path)
+        .status()
+        .unwrap();
+    assert!(status.success());
+
+    let status = Command::new(dir.path().join("bench")).status().unwrap();
+    assert!(status.success());
+}
+
+const SERIALIZATION_BENCHMARK: &str = r#"
+    std::vector<SerdeData> values;
+    for (const auto &sample : samples) {
+        values.push_back(SerdeData::ENCODINGDeserialize(sample));
+    }
+    report("serialize sample values", total_size, [&] {
+        for (const auto &value : values) {
+            auto bytes = value.ENCODINGSerialize();
+            asm volatile("" : : "r"(bytes.data()) : "memory");
+        }
+    });
+    std::vector<uint8_t> batch;
+    report("serialize sample values into batch", total_size, [&] {
+        batch.clear();
+        for (const auto &value : values) {
+            value.ENCODINGSerializeInto(batch);
+        }
+        asm volatile("" : : "r"(batch.data()) : "memory");
+    });
+    report("compute serialized sizes", total_size, [&] {
+        size_t size = 0;
+        for (const auto &value : values) {
+            size += value.ENCODINGSerializedSize();
+        }
+        asm volatile("" : : "r"(size) : "memory");
+    });
+    report("hash sample values", total_size, [&] {
+        size_t hash = 0;
+        for (const auto &value : values) {
+            hash ^= std::hash<SerdeData>{}(value);
+        }
+        asm volatile("" : : "r"(hash) : "memory");
+    });
+"#;
+
+const DESERIALIZATION_BENCHMARK: &str = r#"
+    report("deserialize sample values", total_size, [&] {
+        for (const auto &sample : samples) {
+            auto value = SerdeData::ENCODINGDeserialize(sample);
+            asm volatile("" : : "r"(&value) : "memory");
+        }
+    });
+    std::vector<SerdeData> existing_values;
+    for (const auto &sample : samples) {
+        existing_values.push_back(SerdeData::ENCODINGDeserialize(sample));
+    }
+    report("deserialize sample values into existing values", total_size, [&] {
+        for (size_t i = 0; i < samples.size(); i++) {
+            existing_values[i].ENCODINGDeserializeInto(samples[i]);
+            asm volatile("" : : "r"(&existing_values[i]) : "memory");
+        }
+    });
+    std::vector<std::vector<uint8_t>> truncated_samples;
+    for (const auto &sample : samples) {
+        truncated_samples.emplace_back(sample.begin(), sample.end() - 1);
+    }
+    report("reject truncated values (exceptions)", total_size, [&] {
+        for (const auto &input : truncated_samples) {
+            try {
+                auto value = SerdeData::ENCODINGDeserialize(input);
+                asm volatile("" : : "r"(&value) : "memory");
+            } catch (const serde::deserialization_error &) {
+            }
+        }
+    });
+    report("reject truncated values (results)", total_size, [&] {
+        for (const auto &input : truncated_samples) {
+            auto result = SerdeData::ENCODINGTryDeserialize(input);
+            assert(!result.has_value());
+            asm volatile("" : : "r"(&result) : "memory");
+        }
+    });
+"#;
+
+const BULK_BENCHMARK: &str = r#"
+    std::vector<uint8_t> blob(64 * 1024, 0xab);
+    std::vector<uint64_t> numbers(8 * 1024, 0x0123456789abcdef);
+    std::vector<bool> flags(64 * 1024, true);
+    std::map<std::string, uint64_t> accounts;
+    for (uint64_t i = 0; i < 16 * 1024; i++) {
+        accounts.emplace("account-" + std::to_string(1000000 + i), i);
+    }
+    std::vector<std::string> strings(1024, "The quick brown fox jumps over the lazy dog, \xc3\xa9t\xc3\xa9 \xe2\x82\xac");
+    auto encode = [](const auto &value) {
+        auto serializer = Serializer();
+        serde::Serializable<std::decay_t<decltype(value)>>::serialize(value, serializer);
+        return std::move(serializer).bytes();
+    };
+    auto blob_bytes = encode(blob);
+    auto numbers_bytes = encode(numbers);
+    auto flags_bytes = encode(flags);
+    auto strings_bytes = encode(strings);
+    auto accounts_bytes = encode(accounts);
+    report("serialize 64 KiB blob", blob_bytes.size(), [&] {
+        auto bytes = encode(blob);
+        asm volatile("" : : "r"(bytes.data()) : "memory");
+    });
+    report("deserialize 64 KiB blob", blob_bytes.size(), [&] {
+        auto deserializer = Deserializer(blob_bytes.data(), blob_bytes.size());
+        auto value = serde::Deserializable<std::vector<uint8_t>>::deserialize(deserializer);
+        asm volatile("" : : "r"(value.data()) : "memory");
+    });
+    report("deserialize 8K u64 values", numbers_bytes.size(), [&] {
+        auto deserializer = Deserializer(numbers_bytes.data(), numbers_bytes.size());
+        auto value = serde::Deserializable<std::vector<uint64_t>>::deserialize(deserializer);
+        asm volatile("" : : "r"(value.data()) : "memory");
+    });
+    report("deserialize 64K booleans", flags_bytes.size(), [&] {
+        auto deserializer = Deserializer(flags_bytes.data(), flags_bytes.size());
+        auto value = serde::Deserializable<std::vector<bool>>::deserialize(deserializer);
+        asm volatile("" : : "r"(&value) : "memory");
+    });
+    report("deserialize 1K strings", strings_bytes.size(), [&] {
+        auto deserializer = Deserializer(strings_bytes.data(), strings_bytes.size());
+        auto value = serde::Deserializable<std::vector<std::string>>::deserialize(deserializer);
+        asm volatile("" : : "r"(value.data()) : "memory");
+    });
+    report("deserialize 1K strings into existing vector", strings_bytes.size(), [&] {
+        auto deserializer = Deserializer(strings_bytes.data(), strings_bytes.size());
+        serde::deserialize_into(strings, deserializer);
+        asm volatile("" : : "r"(strings.data()) : "memory");
+    });
+    std::map<uint64_t, uint64_t> balances;
+    std::map<std::array<uint8_t, 32>, uint64_t> addresses;
+    for (uint64_t i = 0; i < 16 * 1024; i++) {
+        balances.emplace(i, i);
+        std::array<uint8_t, 32> address = {(uint8_t)(i * 37), (uint8_t)i, (uint8_t)(i >> 8)};
+        addresses.emplace(address, i);
+    }
+    report("serialize map of 16K entries", accounts_bytes.size(), [&] {
+        auto bytes = encode(accounts);
+        asm volatile("" : : "r"(bytes.data()) : "memory");
+    });
+    report("serialize unsorted map of 16K entries", 16 * 1024 * 16, [&] {
+        auto bytes = encode(balances);
+        asm volatile("" : : "r"(bytes.data()) : "memory");
+    });
+    report("serialize map of 16K address keys", 16 * 1024 * 40, [&] {
+        auto bytes = encode(addresses);
+        asm volatile("" : : "r"(bytes.data()) : "memory");
+    });
+    report("deserialize map of 16K entries", accounts_bytes.size(), [&] {
+        auto deserializer = Deserializer(accounts_bytes.data(), accounts_bytes.size());
+        auto value = serde::Deserializable<std::map<std::string, uint64_t>>::deserialize(deserializer);
+        asm volatile("" : : "r"(&value) : "memory");
+    });
+    report("deserialize map of 16K entries into existing map", accounts_bytes.size(), [&] {
+        auto deserializer = Deserializer(accounts_bytes.data(), accounts_bytes.size());
+        serde::deserialize_into(accounts, deserializer);
+        asm volatile("" : : "r"(&accounts) : "memory");
+    });
+    // `Struct` is not recursive: its container depth is not tracked.
+    std::vector<Struct> structs;
+    for (uint32_t i = 0; i < 4 * 1024; i++) {
+        structs.push_back(Struct{i, (uint64_t)i << 32});
+    }
+    auto structs_bytes = encode(structs);
+    report("serialize 4K flat structs", structs_bytes.size(), [&] {
+        auto bytes = encode(structs);
+        asm volatile("" : : "r"(bytes.data()) : "memory");
+    });
+    report("deserialize 4K flat structs", structs_bytes.size(), [&] {
+        auto deserializer = Deserializer(structs_bytes.data(), structs_bytes.size());
+        auto value = serde::Deserializable<std::vector<Struct>>::deserialize(deserializer);
+        asm volatile("" : : "r"(value.data()) : "memory");
+    });
+"#;
+
+// BCS lengths and variant indices are ULEB128 numbers, most of them of a single byte.
+const ULEB128_BENCHMARK: &str = r#"
+    // Pseudo-random values of 2 to 5 bytes, so that lengths are not predictable.
+    std::vector<uint32_t> small_values, large_values;
+    uint64_t state = 88172645463325252ull;
+    for (uint32_t i = 0; i < 64 * 1024; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        uint32_t large_value = ((uint32_t)state >> (7 * (state >> 62))) | 0x80;
+        small_values.push_back(i % 32 == 0 ? large_value : i % 100);
+        large_values.push_back(large_value);
+    }
+    for (const auto *values : {&small_values, &large_values}) {
+        auto serializer = Serializer();
+        for (auto value : *values) {
+            serializer.serialize_variant_index(value);
+        }
+        auto bytes = std::move(serializer).bytes();
+        const char *kind = values == &small_values ? "mostly 1-byte" : "multi-byte";
+        char name[64];
+        snprintf(name, sizeof(name), "encode 64K %s uleb128", kind);
+        report(name, bytes.size(), [&] {
+            auto serializer = Serializer();
+            for (auto value : *values) {
+                serializer.serialize_variant_index(value);
+            }
+            auto output = std::move(serializer).bytes();
+            asm volatile("" : : "r"(output.data()) : "memory");
+        });
+        // Baseline: one `push_back` per byte.
+        snprintf(name, sizeof(name), "encode 64K %s uleb128 (loop)", kind);
+        report(name, bytes.size(), [&] {
+            std::vector<uint8_t> output;
+            for (auto value : *values) {
+                while (value >= 0x80) {
+                    output.push_back((uint8_t)((value & 0x7F) | 0x80));
+                    value >>= 7;
+                }
+                output.push_back((uint8_t)value);
+            }
+            asm volatile("" : : "r"(output.data()) : "memory");
+        });
+        snprintf(name, sizeof(name), "decode 64K %s uleb128", kind);
+        report(name, bytes.size(), [&] {
+            auto deserializer = Deserializer(bytes.data(), bytes.size());
+            uint32_t sum = 0;
+            for (size_t i = 0; i < values->size(); i++) {
+                sum += deserializer.deserialize_variant_index();
+            }
+            asm volatile("" : : "r"(sum) : "memory");
+        });
+        // Baseline: one bounds check per byte.
+        snprintf(name, sizeof(name), "decode 64K %s uleb128 (bytewise)", kind);
+        report(name, bytes.size(), [&] {
+            auto deserializer = Deserializer(bytes.data(), bytes.size());
+            uint32_t sum = 0;
+            for (size_t i = 0; i < values->size(); i++) {
+                sum += deserializer.deserialize_uleb128_as_u32_bytewise();
+            }
+            asm volatile("" : : "r"(sum) : "memory");
+        });
+    }
+"#;
+
+// `SimpleList` is a recursive type: decoding time should grow linearly with the depth.
+const DEEP_LIST_BENCHMARK: &str = r#"
+    for (size_t depth : {50, 100, 200, 400}) {
+        std::vector<uint8_t> input(depth, 1);
+        input.push_back(0);
+        auto list = SimpleList::ENCODINGDeserialize(input);
+        assert(list.ENCODINGSerialize() == input);
+        char name[64];
+        snprintf(name, sizeof(name), "deserialize list of depth %zu", depth);
+        report(name, input.size(), [&] {
+            auto value = SimpleList::ENCODINGDeserialize(input);
+            asm volatile("" : : "r"(&value) : "memory");
+        });
+    }
+"#;
+
+#[test]
+#[ignore]
+fn bench_cpp_bcs_serialization() {
+    run_cpp_benchmark(
+        Runtime::Bcs,
+        &SERIALIZATION_BENCHMARK.replace("ENCODING", Runtime::Bcs.name()),
+    );
+}
+
+#[test]
+#[ignore]
+fn bench_cpp_bincode_serialization() {
+    run_cpp_benchmark(
+        Runtime::Bincode,
+        &SERIALIZATION_BENCHMARK.replace("ENCODING", Runtime::Bincode.name()),
+    );
+}
+
+#[test]
+#[ignore]
+fn bench_cpp_bcs_deserialization() {
+    run_cpp_benchmark(
+        Runtime::Bcs,
+        &DESERIALIZATION_BENCHMARK.replace("ENCODING", Runtime::Bcs.name()),
+    );
+}
+
+#[test]
+#[ignore]
+fn bench_cpp_bincode_deserialization() {
+    run_cpp_benchmark(
+        Runtime::Bincode,
+        &DESERIALIZATION_BENCHMARK.replace("ENCODING", Runtime::Bincode.name()),
+    );
+}
+
+#[test]
+#[ignore]
+fn bench_cpp_bcs_bulk() {
+    run_cpp_benchmark(Runtime::Bcs, BULK_BENCHMARK);
+}
+
+#[test]
+#[ignore]
+fn bench_cpp_bincode_bulk() {
+    run_cpp_benchmark(Runtime::Bincode, BULK_BENCHMARK);
+}
+
+#[test]
+#[ignore]
+fn bench_cpp_bcs_uleb128() {
+    run_cpp_benchmark(Runtime::Bcs, ULEB128_BENCHMARK);
+}
+
+#[test]
+#[ignore]
+fn bench_cpp_bcs_deep_list() {
+    run_cpp_benchmark(
+        Runtime::Bcs,
+        &DEEP_LIST_BENCHMARK.replace("ENCODING", Runtime::Bcs.name()),
+    );
+}
+
+#[test]
+#[ignore]
+fn bench_cpp_bincode_deep_list() {
+    run_cpp_benchmark(
+        Runtime::Bincode,
+        &DEEP_LIST_BENCHMARK.replace("ENCODING", Runtime::Bincode.name()),
+    );
+}
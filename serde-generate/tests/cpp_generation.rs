@@ -68,6 +68,22 @@ fn test_that_cpp_code_compiles_without_serialization() {
     test_that_cpp_code_compiles_with_config(&config);
 }
 
+#[test]
+fn test_that_cpp_code_compiles_with_native_128bit_integers() {
+    let config = CodeGeneratorConfig::new("testing".to_string())
+        .with_encodings(vec![Encoding::Bcs, Encoding::Bincode])
+        .with_native_128bit_integers(true);
+    test_that_cpp_code_compiles_with_config(&config);
+}
+
+#[test]
+fn test_that_cpp_code_compiles_with_polymorphic_allocators() {
+    let config = CodeGeneratorConfig::new("testing".to_string())
+        .with_encodings(vec![Encoding::Bcs, Encoding::Bincode])
+        .with_polymorphic_allocators(true);
+    test_that_cpp_code_compiles_with_config(&config);
+}
+
 #[test]
 fn test_that_cpp_code_compiles_with_comments() {
     let comments = vec![
@@ -125,6 +141,65 @@ fn test_cpp_code_with_external_definitions() {
     assert!(!content.contains("testing::Tree"));
 }
 
+#[test]
+fn test_that_cpp_code_compiles_with_external_definitions() {
+    // "Struct" is provided by the namespace "pkg", without specializing `std::hash`.
+    let registry = test_utils::get_registry().unwrap();
+    let mut definitions = BTreeMap::new();
+    definitions.insert("pkg".to_string(), vec!["Struct".to_string()]);
+    let config = CodeGeneratorConfig::new("testing".to_string())
+        .with_encodings(vec![Encoding::Bcs])
+        .with_external_definitions(definitions);
+    let dir = tempdir().unwrap();
+    let header_path = dir.path().join("test.hpp");
+    let mut header = File::create(&header_path).unwrap();
+    let generator = cpp::CodeGenerator::new(&config);
+    generator.output(&mut header, &registry).unwrap();
+
+    let content = std::fs::read_to_string(&header_path).unwrap();
+    assert!(content.contains("std::vector<pkg::Struct> f_seq;"));
+    assert!(!content.contains("std::hash<pkg::Struct>"));
+    assert!(!content.contains("std::hash<testing::SerdeData>"));
+    assert!(content.contains("std::hash<testing::UnitStruct>"));
+
+    let source_path = dir.path().join("test.cpp");
+    let mut source = File::create(&source_path).unwrap();
+    writeln!(
+        source,
+        r#"
+#include "serde.hpp"
+
+namespace pkg {{
+
+struct Struct {{
+    uint32_t x;
+    uint64_t y;
+}};
+
+inline bool operator==(const Struct &lhs, const Struct &rhs) {{
+    return lhs.x == rhs.x && lhs.y == rhs.y;
+}}
+
+}} // end of namespace pkg
+
+#include "test.hpp"
+"#
+    )
+    .unwrap();
+
+    let status = Command::new("clang++")
+        .arg("--std=c++17")
+        .arg("-c")
+        .arg("-o")
+        .arg(dir.path().join("test.o"))
+        .arg("-I")
+        .arg("runtime/cpp")
+        .arg(&source_path)
+        .status()
+        .unwrap();
+    assert!(status.success());
+}
+
 #[test]
 fn test_that_cpp_code_compiles_with_custom_code() {
     let custom_code = vec![
@@ -153,6 +228,32 @@ fn test_that_cpp_code_compiles_with_custom_code() {
     assert!(content.contains("~Node"));
 }
 
+#[test]
+fn test_that_cpp_code_compiles_with_polymorphic_allocators_and_custom_code() {
+    // Constructors and virtual destructors prevent aggregate initialization.
+    let custom_code = vec![
+        (
+            vec!["testing".to_string(), "Struct".to_string()],
+            "Struct() = default;\nexplicit Struct(uint32_t x) : x(x), y(0) {}".to_string(),
+        ),
+        (
+            vec![
+                "testing".to_string(),
+                "List".to_string(),
+                "Node".to_string(),
+            ],
+            "virtual ~Node() = default;".to_string(),
+        ),
+    ]
+    .into_iter()
+    .collect();
+    let config = CodeGeneratorConfig::new("testing".to_string())
+        .with_encodings(vec![Encoding::Bcs, Encoding::Bincode])
+        .with_polymorphic_allocators(true)
+        .with_custom_code(custom_code);
+    test_that_cpp_code_compiles_with_config(&config);
+}
+
 #[test]
 fn test_that_cpp_code_links() {
     let registry = test_utils::get_registry().unwrap();
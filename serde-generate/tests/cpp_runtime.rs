@@ -1,14 +1,48 @@
 // Copyright (c) Facebook, Inc. and its affiliates
 // SPDX-License-Identifier: MIT OR Apache-2.0
 
+use heck::CamelCase;
 use serde_generate::{
     cpp, test_utils,
     test_utils::{Choice, Runtime, Test},
     CodeGeneratorConfig,
 };
-use std::{fs::File, io::Write, process::Command};
+use serde_reflection::{ContainerFormat, Format, Named, Registry, VariantFormat};
+use std::{collections::BTreeMap, fs::File, process::Command};
 use tempfile::tempdir;
 
+// Compile the C++ program `source` with the given extra compiler flags, then run it. The program
+// may include the header "test.hpp" generated from a registry and a config, if provided.
+fn run_cpp_test(
+    generated: Option<(&Registry, &CodeGeneratorConfig)>,
+    flags: &[&str],
+    source: &str,
+) {
+    let dir = tempdir().unwrap();
+    if let Some((registry, config)) = generated {
+        let mut header = File::create(dir.path().join("test.hpp")).unwrap();
+        let generator = cpp::CodeGenerator::new(config);
+        generator.output(&mut header, registry).unwrap();
+    }
+    let source_path = dir.path().join("test.cpp");
+    std::fs::write(&source_path, source).unwrap();
+
+    let status = Command::new("clang++")
+        .arg("--std=c++17")
+        .args(flags)
+        .arg("-o")
+        .arg(dir.path().join("test"))
+        .arg("-I")
+        .arg("runtime/cpp")
+        .arg(source_path)
+        .status()
+        .unwrap();
+    assert!(status.success());
+
+    let status = Command::new(dir.path().join("test")).status().unwrap();
+    assert!(status.success());
+}
+
 #[test]
 fn test_cpp_bcs_runtime_on_simple_date() {
     test_cpp_runtime_on_simple_date(Runtime::Bcs);
@@ -21,14 +55,8 @@ fn test_cpp_bincode_runtime_on_simple_date() {
 
 fn test_cpp_runtime_on_simple_date(runtime: Runtime) {
     let registry = test_utils::get_simple_registry().unwrap();
-    let dir = tempdir().unwrap();
-    let header_path = dir.path().join("test.hpp");
-    let mut header = File::create(&header_path).unwrap();
-
     let config =
         CodeGeneratorConfig::new("testing".to_string()).with_encodings(vec![runtime.into()]);
-    let generator = cpp::CodeGenerator::new(&config);
-    generator.output(&mut header, &registry).unwrap();
 
     let reference = runtime.serialize(&Test {
         a: vec![4, 6],
@@ -36,11 +64,9 @@ fn test_cpp_runtime_on_simple_date(runtime: Runtime) {
         c: Choice::C { x: 7 },
     });
 
-    let source_path = dir.path().join("test.cpp");
-    let mut source = File::create(&source_path).unwrap();
-    writeln!(
-        source,
+    let source = format!(
         r#"
+#include <algorithm>
 #include <cassert>
 #include "test.hpp"
 
@@ -49,6 +75,7 @@ using namespace testing;
 int main() {{
     std::vector<uint8_t> input = {{{0}}};
     auto value = Test::{1}Deserialize(input);
+    assert(Test::{1}Deserialize(input.data(), input.size()) == value);
 
     auto a = std::vector<uint32_t> {{4, 6}};
     auto b = std::tuple<int64_t, uint64_t> {{-3, 5}};
@@ -57,10 +84,59 @@ int main() {{
 
     assert(value == value2);
 
+    auto deserializer = serde::{2}Deserializer(input.data(), input.size());
+    auto value3 = serde::Deserializable<Test>::deserialize(deserializer);
+    assert(deserializer.get_buffer_offset() == input.size());
+    assert(value == value3);
+
     auto output = value2.{1}Serialize();
 
     assert(input == output);
 
+    std::vector<uint8_t> batch = {{0xff}};
+    value2.{1}SerializeInto(batch);
+    value2.{1}SerializeInto(batch);
+    assert(batch.size() == 1 + 2 * input.size());
+    assert(std::equal(input.begin(), input.end(), batch.begin() + 1));
+    assert(std::equal(input.begin(), input.end(), batch.begin() + 1 + input.size()));
+
+    assert(value2.{1}SerializedSize() == input.size());
+
+    auto serializer = serde::{2}Serializer();
+    serializer.sink().reserve(value2.{1}SerializedSize());
+    serde::Serializable<Test>::serialize(value2, serializer);
+    assert(serializer.sink().size() == input.size());
+    serializer.reset();
+    serde::Serializable<Test>::serialize(value2, serializer);
+    assert(std::move(serializer).bytes() == input);
+
+    using Encoding = serde::{2}Encoding;
+    constexpr auto bounds = serde::encoded_size_bounds<Choice, Encoding>;
+    static_assert(bounds.is_bounded() && !bounds.is_fixed());
+    static_assert(serde::encoded_size_bounds<decltype(b), Encoding>.is_fixed());
+    static_assert(serde::encoded_size_bounds<decltype(b), Encoding>.min == 16);
+    static_assert(!serde::encoded_size_bounds<Test, Encoding>.is_bounded());
+    static_assert(serde::encoded_size_bounds<double, Encoding>.is_fixed() ==
+                  Encoding::has_floats);
+    static_assert(serde::encoded_order_matches_less<Choice, Encoding> ==
+                  Encoding::is_ordered_by_compare_encodings);
+
+    std::array<uint8_t, bounds.max> buffer;
+    auto fixed_serializer = serde::Basic{2}Serializer<serde::FixedBufferSink>(
+        serde::FixedBufferSink(buffer.data(), buffer.size()));
+    serde::Serializable<Choice>::serialize(c, fixed_serializer);
+    auto size = fixed_serializer.sink().size();
+    assert(size >= bounds.min);
+    assert(c.{1}Serialize() == std::vector<uint8_t>(buffer.begin(), buffer.begin() + size));
+
+    try {{
+        // Choice only has 3 variants.
+        Choice::{1}Deserialize(std::vector<uint8_t>{{3, 0, 0, 0}});
+        return 1;
+    }} catch (serde::deserialization_error &e) {{
+        // All good
+    }}
+
     input.push_back(1);
     try {{
         Test::{1}Deserialize(input);
@@ -76,32 +152,29 @@ int main() {{
             .collect::<Vec<_>>()
             .join(", "),
         runtime.name(),
-    )
-    .unwrap();
-
-    let status = Command::new("clang++")
-        .arg("--std=c++17")
-        .arg("-o")
-        .arg(dir.path().join("test"))
-        .arg("-I")
-        .arg("runtime/cpp")
-        .arg(source_path)
-        .status()
-        .unwrap();
-    assert!(status.success());
-
-    let status = Command::new(dir.path().join("test")).status().unwrap();
-    assert!(status.success());
+        runtime.name().to_camel_case(),
+    );
+    run_cpp_test(Some((&registry, &config)), &[], &source);
 }
 
 #[test]
 fn test_cpp_bcs_runtime_on_supported_types() {
-    test_cpp_runtime_on_supported_types(Runtime::Bcs);
+    test_cpp_runtime_on_supported_types(Runtime::Bcs, false, false);
 }
 
 #[test]
 fn test_cpp_bincode_runtime_on_supported_types() {
-    test_cpp_runtime_on_supported_types(Runtime::Bincode);
+    test_cpp_runtime_on_supported_types(Runtime::Bincode, false, false);
+}
+
+#[test]
+fn test_cpp_bcs_runtime_on_supported_types_with_native_integers() {
+    test_cpp_runtime_on_supported_types(Runtime::Bcs, true, false);
+}
+
+#[test]
+fn test_cpp_bcs_runtime_on_supported_types_with_polymorphic_allocators() {
+    test_cpp_runtime_on_supported_types(Runtime::Bcs, false, true);
 }
 
 fn quote_bytes(bytes: &[u8]) -> String {
@@ -115,16 +188,16 @@ fn quote_bytes(bytes: &[u8]) -> String {
     )
 }
 
-fn test_cpp_runtime_on_supported_types(runtime: Runtime) {
+fn test_cpp_runtime_on_supported_types(
+    runtime: Runtime,
+    native_128bit_integers: bool,
+    polymorphic_allocators: bool,
+) {
     let registry = test_utils::get_registry().unwrap();
-    let dir = tempdir().unwrap();
-    let header_path = dir.path().join("test.hpp");
-    let mut header = File::create(&header_path).unwrap();
-
-    let config =
-        CodeGeneratorConfig::new("testing".to_string()).with_encodings(vec![runtime.into()]);
-    let generator = cpp::CodeGenerator::new(&config);
-    generator.output(&mut header, &registry).unwrap();
+    let config = CodeGeneratorConfig::new("testing".to_string())
+        .with_encodings(vec![runtime.into()])
+        .with_native_128bit_integers(native_128bit_integers)
+        .with_polymorphic_allocators(polymorphic_allocators);
 
     let positive_encodings: Vec<_> = runtime
         .get_positive_samples()
@@ -138,15 +211,14 @@ fn test_cpp_runtime_on_supported_types(runtime: Runtime) {
         .map(|bytes| quote_bytes(bytes))
         .collect();
 
-    let source_path = dir.path().join("test.cpp");
-    let mut source = File::create(&source_path).unwrap();
-    writeln!(
-        source,
+    let source = format!(
         r#"
 #include <algorithm>
 #include <exception>
 #include <iostream>
 #include <cassert>
+#include <set>
+#include <unordered_set>
 #include "test.hpp"
 
 using namespace testing;
@@ -155,6 +227,18 @@ int main() {{
     std::vector<std::vector<uint8_t>> positive_inputs = {{{0}}};
     std::vector<std::vector<uint8_t>> negative_inputs = {{{1}}};
     try {{
+        // Test hashing: equal values have equal hashes.
+        std::unordered_set<SerdeData> values;
+        for (auto input: positive_inputs) {{
+            auto value = SerdeData::{2}Deserialize(input);
+            auto value2 = SerdeData::{2}Deserialize(input);
+            assert(std::hash<SerdeData>{{}}(value) == std::hash<SerdeData>{{}}(value2));
+            values.insert(std::move(value));
+            assert(values.count(value2) == 1);
+        }}
+        std::set<std::vector<uint8_t>> distinct_inputs(positive_inputs.begin(), positive_inputs.end());
+        assert(values.size() == distinct_inputs.size());
+
         for (auto input: positive_inputs) {{
             auto value = SerdeData::{2}Deserialize(input);
             auto output = value.{2}Serialize();
@@ -164,6 +248,46 @@ int main() {{
             {{
                 auto value2 = SerdeData::{2}Deserialize(input);
                 assert(value == value2);
+                auto result = SerdeData::{2}TryDeserialize(input);
+                assert(result.has_value() && *result == value);
+            }}
+
+            // Test allocating values from a memory resource. With `std::pmr`
+            // containers, the default resource is not used at all.
+#ifdef SERDE_HAS_PMR
+            {{
+                std::pmr::monotonic_buffer_resource arena;
+                auto default_resource = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+                auto deserializer = serde::{3}Deserializer(input);
+                deserializer.set_memory_resource(&arena);
+                auto value2 = serde::Deserializable<SerdeData>::deserialize(deserializer);
+                std::pmr::set_default_resource(default_resource);
+                assert(value2 == value);
+            }}
+#endif
+
+            // Test deserializing into values that already hold data.
+            for (auto input2 : positive_inputs) {{
+                auto value2 = SerdeData::{2}Deserialize(input2);
+                value2.{2}DeserializeInto(input);
+                assert(value2 == value);
+            }}
+
+            // Test that deserializing into an equal value reuses all its memory.
+            {{
+                auto value2 = value;
+                auto deserializer = serde::{3}Deserializer(input);
+                deserializer.set_allocation_budget(0);
+                serde::deserialize_into(value2, deserializer);
+                assert(value2 == value);
+            }}
+
+            // Test that values are ordered like their encodings, if the encoding is canonical.
+            if (serde::{3}Serializer::encoding::is_ordered_by_compare_encodings) {{
+                for (auto input2 : positive_inputs) {{
+                    auto value2 = SerdeData::{2}Deserialize(input2);
+                    assert((value < value2) == (input < input2));
+                }}
             }}
 
             // Test simple mutations of the input.
@@ -180,6 +304,23 @@ int main() {{
                 }} catch (std::length_error const &e) {{
                     // All good
                 }}
+
+                // The non-throwing API reports the same errors.
+                try {{
+                    auto result = SerdeData::{2}TryDeserialize(input2);
+                    try {{
+                        auto value2 = SerdeData::{2}Deserialize(input2);
+                        assert(result.has_value() && *result == value2);
+                    }} catch (serde::deserialization_error &e) {{
+                        assert(!result.has_value());
+                        assert(std::string(e.what()) == result.error().message);
+                        assert(result.error().offset <= input2.size());
+                    }}
+                }} catch (std::bad_alloc const &e) {{
+                    // All good
+                }} catch (std::length_error const &e) {{
+                    // All good
+                }}
             }}
         }}
 
@@ -195,6 +336,7 @@ int main() {{
             }} catch (serde::deserialization_error e) {{
                 // All good
             }}
+            assert(!SerdeData::{2}TryDeserialize(input).has_value());
         }}
         return 0;
     }} catch (std::exception& e) {{
@@ -206,22 +348,896 @@ int main() {{
         positive_encodings.join(", "),
         negative_encodings.join(", "),
         runtime.name(),
-    )
-    .unwrap();
+        runtime.name().to_camel_case(),
+    );
+    run_cpp_test(Some((&registry, &config)), &["-g", "-O3"], &source);
+}
 
-    let status = Command::new("clang++")
-        .arg("--std=c++17")
-        .arg("-g")
-        .arg("-O3") // remove for debugging
-        .arg("-o")
-        .arg(dir.path().join("test"))
-        .arg("-I")
-        .arg("runtime/cpp")
-        .arg(source_path)
-        .status()
-        .unwrap();
-    assert!(status.success());
+#[test]
+fn test_cpp_bcs_runtime_output_sinks() {
+    test_cpp_runtime_output_sinks(Runtime::Bcs);
+}
 
-    let status = Command::new(dir.path().join("test")).status().unwrap();
-    assert!(status.success());
+#[test]
+fn test_cpp_bincode_runtime_output_sinks() {
+    test_cpp_runtime_output_sinks(Runtime::Bincode);
+}
+
+fn test_cpp_runtime_output_sinks(runtime: Runtime) {
+    let registry = test_utils::get_registry().unwrap();
+    let config =
+        CodeGeneratorConfig::new("testing".to_string()).with_encodings(vec![runtime.into()]);
+
+    let positive_encodings: Vec<_> = runtime
+        .get_positive_samples_quick()
+        .iter()
+        .map(|bytes| quote_bytes(bytes))
+        .collect();
+
+    let source = format!(
+        r#"
+#include <cassert>
+#include <cstdio>
+#include "test.hpp"
+
+using namespace testing;
+
+template <class Sink>
+using Serializer = serde::Basic{1}Serializer<Sink>;
+
+int main() {{
+    std::vector<std::vector<uint8_t>> positive_inputs = {{{0}}};
+    for (auto input: positive_inputs) {{
+        auto value = SerdeData::{2}Deserialize(input);
+
+        std::vector<uint8_t> buffer(input.size());
+        Serializer<serde::FixedBufferSink> fixed(serde::FixedBufferSink(buffer.data(), buffer.size()));
+        serde::Serializable<SerdeData>::serialize(value, fixed);
+        assert(fixed.get_buffer_offset() == input.size());
+        assert(buffer == input);
+
+        if (input.size() > 0) {{
+            Serializer<serde::FixedBufferSink> small(serde::FixedBufferSink(buffer.data(), input.size() - 1));
+            try {{
+                serde::Serializable<SerdeData>::serialize(value, small);
+                assert(false);
+            }} catch (serde::serialization_error &e) {{
+                // All good
+            }}
+        }}
+
+        Serializer<serde::CountingSink> counting;
+        serde::Serializable<SerdeData>::serialize(value, counting);
+        assert(counting.get_buffer_offset() == input.size());
+
+        FILE *file = tmpfile();
+        {{
+            // Use a small buffer to exercise flushing.
+            Serializer<serde::FileDescriptorSink> writer(serde::FileDescriptorSink(fileno(file), 16));
+            serde::Serializable<SerdeData>::serialize(value, writer);
+            assert(writer.get_buffer_offset() == input.size());
+        }}
+        std::vector<uint8_t> output(input.size() + 1);
+        rewind(file);
+        assert(fread(output.data(), 1, output.size(), file) == input.size());
+        output.pop_back();
+        assert(output == input);
+        fclose(file);
+    }}
+    return 0;
+}}
+"#,
+        positive_encodings.join(", "),
+        runtime.name().to_camel_case(),
+        runtime.name(),
+    );
+    run_cpp_test(Some((&registry, &config)), &[], &source);
+}
+
+#[test]
+fn test_cpp_runtime_file_descriptor_sink_errors() {
+    let source = format!(
+        r#"
+#include <cassert>
+#include <fcntl.h>
+#include "bcs.hpp"
+
+int main() {{
+    // Writes to a full non-blocking pipe fail after a partial write.
+    int fds[2];
+    assert(pipe(fds) == 0);
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+
+    std::vector<uint8_t> input(1 << 20);
+    for (size_t i = 0; i < input.size(); i++) {{
+        input[i] = (uint8_t)(i % 251);
+    }}
+    std::vector<uint8_t> output(input.size());
+    size_t output_size = 0;
+    {{
+        serde::FileDescriptorSink sink(fds[1], input.size());
+        sink.append(input.data(), input.size() - 1);
+        try {{
+            sink.flush();
+            assert(false);
+        }} catch (serde::serialization_error &e) {{
+            // All good
+        }}
+        assert(sink.size() == input.size() - 1);
+
+        // Nothing is written after an error, even if the pipe is drained.
+        auto n = read(fds[0], output.data(), output.size());
+        assert(n > 0 && (size_t)n < input.size() - 1);
+        output_size = n;
+        try {{
+            sink.flush();
+            assert(false);
+        }} catch (serde::serialization_error &e) {{
+            // All good
+        }}
+    }}
+    // The sink is destroyed without writing the bytes again.
+    assert(read(fds[0], output.data() + output_size, output.size() - output_size) < 0);
+    assert(std::equal(output.begin(), output.begin() + output_size, input.begin()));
+    close(fds[0]);
+    close(fds[1]);
+    return 0;
+}}
+"#
+    );
+    run_cpp_test(None, &[], &source);
+}
+
+#[test]
+fn test_cpp_bcs_runtime_bulk_sequences() {
+    test_cpp_runtime_bulk_sequences(Runtime::Bcs);
+}
+
+#[test]
+fn test_cpp_bincode_runtime_bulk_sequences() {
+    test_cpp_runtime_bulk_sequences(Runtime::Bincode);
+}
+
+// Sequences and arrays of primitive types are (de)serialized in bulk. Maps may use custom
+// comparators, or keys that are already in the order of their encodings.
+fn test_cpp_runtime_bulk_sequences(runtime: Runtime) {
+    let source = format!(
+        r#"
+#include <cassert>
+#include "{0}.hpp"
+
+template <typename T>
+void check_roundtrip(const T &value, size_t expected_size) {{
+    auto serializer = serde::{1}Serializer();
+    serde::Serializable<T>::serialize(value, serializer);
+    auto bytes = std::move(serializer).bytes();
+    assert(bytes.size() == expected_size);
+
+    auto deserializer = serde::{1}Deserializer(bytes);
+    assert(serde::Deserializable<T>::deserialize(deserializer) == value);
+    assert(deserializer.get_buffer_offset() == bytes.size());
+
+    for (size_t size = 0; size < bytes.size(); size++) {{
+        auto deserializer = serde::{1}Deserializer(bytes.data(), size);
+        try {{
+            serde::Deserializable<T>::deserialize(deserializer);
+            assert(false);
+        }} catch (serde::deserialization_error &e) {{
+            // All good
+        }}
+    }}
+}}
+
+template <typename T>
+void check_order(const T &lhs, const T &rhs) {{
+    auto encode = [](const T &value) {{
+        auto serializer = serde::{1}Serializer();
+        serde::Serializable<T>::serialize(value, serializer);
+        return std::move(serializer).bytes();
+    }};
+    int order = serde::compare_encodings(lhs, rhs);
+    assert((order < 0) == (encode(lhs) < encode(rhs)));
+    assert((order == 0) == (encode(lhs) == encode(rhs)));
+    assert(serde::compare_encodings(rhs, lhs) == -order);
+}}
+
+int main() {{
+    size_t len = {2};
+    check_roundtrip(std::vector<uint8_t>(100, 7), len + 100);
+    check_roundtrip(std::vector<int16_t>{{-1, 2, 3}}, len + 6);
+    check_roundtrip(std::vector<uint64_t>{{1, 1ull << 63}}, len + 16);
+    check_roundtrip(std::vector<bool>{{true, false, true}}, len + 3);
+    check_roundtrip(std::array<int32_t, 3>{{-5, 0, 5}}, 12);
+    check_roundtrip(std::array<bool, 2>{{false, true}}, 2);
+
+    // Maps with a custom comparator.
+    using Map = std::map<uint8_t, std::string, std::greater<uint8_t>>;
+    check_roundtrip(Map{{{{1, "a"}}, {{2, "b"}}, {{3, "c"}}}}, len + 3 * (2 + len));
+
+    // Maps whose keys are ordered like their encodings.
+    using Encoding = typename serde::{1}Serializer::encoding;
+    static_assert(serde::encoded_order_matches_less<std::array<uint8_t, 2>, Encoding>);
+    static_assert(serde::encoded_order_matches_less<std::optional<uint8_t>, Encoding>);
+    static_assert(serde::encoded_order_matches_less<
+                  std::tuple<bool, std::variant<std::monostate, uint8_t>>, Encoding>);
+    static_assert(!serde::encoded_order_matches_less<uint16_t, Encoding>);
+    static_assert(!serde::encoded_order_matches_less<int8_t, Encoding>);
+    static_assert(!serde::encoded_order_matches_less<std::string, Encoding>);
+    using ArrayMap = std::map<std::array<uint8_t, 2>, uint8_t>;
+    check_roundtrip(ArrayMap{{{{{{1, 2}}, 3}}, {{{{2, 0}}, 4}}}}, len + 2 * 3);
+    using OptionMap = std::map<std::optional<uint8_t>, bool>;
+    check_roundtrip(OptionMap{{{{std::nullopt, true}}, {{5, false}}}}, len + 5);
+
+    // Values compared like their BCS encodings.
+    if (Encoding::is_ordered_by_compare_encodings) {{
+        check_order<uint16_t>(0x0100, 0x0001);
+        check_order<int32_t>(-1, 1);
+        check_order(serde::uint128_t{{0, 1}}, serde::uint128_t{{1, 0}});
+        check_order<std::string>("b", "aa");
+        check_order(std::string(129, 'a'), std::string(256, 'a'));
+        check_order(std::vector<uint64_t>{{1, 2}}, std::vector<uint64_t>{{1, 3}});
+        check_order(std::vector<bool>{{true}}, std::vector<bool>{{false, false}});
+        check_order(std::optional<uint16_t>(), std::optional<uint16_t>(0));
+        check_order(std::variant<uint8_t, std::string>(std::string("a")),
+                    std::variant<uint8_t, std::string>(uint8_t(1)));
+        check_order(std::tuple<uint8_t, std::string>(1, "b"),
+                    std::tuple<uint8_t, std::string>(1, "aa"));
+        using StringMap = std::map<std::string, uint8_t>;
+        check_order(StringMap{{{{"aa", 1}}, {{"b", 2}}}}, StringMap{{{{"aa", 2}}, {{"b", 1}}}});
+        check_order(StringMap{{{{"aa", 1}}}}, StringMap{{{{"aa", 1}}}});
+    }}
+
+    auto serializer = serde::{1}Serializer();
+    serde::Serializable<std::vector<uint16_t>>::serialize({{0x0102}}, serializer);
+    auto bytes = std::move(serializer).bytes();
+    assert(bytes.back() == 0x01 && bytes[bytes.size() - 2] == 0x02);
+
+    serializer = serde::{1}Serializer();
+    serde::Serializable<std::vector<bool>>::serialize({{true, false, true}}, serializer);
+    bytes = std::move(serializer).bytes();
+    bytes.back() = 2;
+    auto deserializer = serde::{1}Deserializer(bytes);
+    try {{
+        serde::Deserializable<std::vector<bool>>::deserialize(deserializer);
+        assert(false);
+    }} catch (serde::deserialization_error &e) {{
+        // All good
+    }}
+
+    // Forged lengths are rejected before decoding (or allocating) any element.
+    serializer = serde::{1}Serializer();
+    serializer.serialize_len(0x7fffffff);
+    serializer.serialize_str("abc");
+    bytes = std::move(serializer).bytes();
+    deserializer = serde::{1}Deserializer(bytes);
+    try {{
+        serde::Deserializable<std::vector<std::string>>::deserialize(deserializer);
+        assert(false);
+    }} catch (serde::deserialization_error &e) {{
+        assert(std::string(e.what()) == "Input is not large enough");
+    }}
+    return 0;
+}}
+"#,
+        runtime.name(),
+        runtime.name().to_camel_case(),
+        match runtime {
+            Runtime::Bcs => 1,
+            Runtime::Bincode => 8,
+        },
+    );
+    run_cpp_test(None, &[], &source);
+}
+
+#[test]
+fn test_cpp_runtime_utf8_validation() {
+    let source = format!(
+        r#"
+#include <cassert>
+#include <string>
+#include "bcs.hpp"
+
+int main() {{
+    std::string long_ascii(100, 'a');
+    for (auto valid : {{
+             std::string(""),
+             long_ascii,
+             long_ascii + "\xc3\xa9" + long_ascii,
+             std::string("\xe2\x82\xac \xed\x9f\xbf \xee\x80\x80"),
+             std::string("\xf0\x90\x80\x80 \xf4\x8f\xbf\xbf"),
+         }}) {{
+        assert(serde::is_valid_utf8(valid));
+    }}
+    for (auto invalid : {{
+             // Unexpected continuation byte
+             long_ascii + "\x80",
+             // Truncated codepoints
+             long_ascii + "\xc3",
+             std::string("\xe2\x82"),
+             // Overlong encodings
+             std::string("\xc0\xaf"),
+             std::string("\xe0\x80\xaf"),
+             std::string("\xf0\x80\x80\xaf"),
+             // Surrogates
+             std::string("\xed\xa0\x80"),
+             // Above U+10FFFF
+             std::string("\xf4\x90\x80\x80"),
+             std::string("\xf8\x88\x80\x80\x80"),
+         }}) {{
+        assert(!serde::is_valid_utf8(invalid));
+
+        auto serializer = serde::BcsSerializer();
+        serializer.serialize_str(invalid);
+        auto deserializer = serde::BcsDeserializer(std::move(serializer).bytes());
+        try {{
+            deserializer.deserialize_str();
+            assert(false);
+        }} catch (serde::deserialization_error &e) {{
+            assert(std::string(e.what()) == "Invalid UTF8 string");
+        }}
+    }}
+    return 0;
+}}
+"#
+    );
+    run_cpp_test(None, &[], &source);
+}
+
+#[test]
+fn test_cpp_runtime_128bit_integers() {
+    let source = format!(
+        r#"
+#include <cassert>
+#include "bcs.hpp"
+
+using serde::int128_t;
+using serde::uint128_t;
+
+template <typename T>
+std::vector<uint8_t> encode(const T &value) {{
+    auto serializer = serde::BcsSerializer();
+    serde::Serializable<T>::serialize(value, serializer);
+    return std::move(serializer).bytes();
+}}
+
+template <typename T>
+T decode(const std::vector<uint8_t> &bytes) {{
+    auto deserializer = serde::BcsDeserializer(bytes);
+    return serde::Deserializable<T>::deserialize(deserializer);
+}}
+
+int main() {{
+    // Numeric order.
+    std::vector<uint128_t> unsigned_values = {{
+        {{0, 0}}, {{0, 1}}, {{0, UINT64_MAX}}, {{1, 0}}, {{UINT64_MAX, UINT64_MAX}}}};
+    std::vector<int128_t> signed_values = {{
+        {{INT64_MIN, 0}}, {{-1, 0}}, {{-1, UINT64_MAX}}, {{0, 0}}, {{0, 1}},
+        {{INT64_MAX, UINT64_MAX}}}};
+    for (size_t i = 0; i < unsigned_values.size(); i++) {{
+        for (size_t j = 0; j < unsigned_values.size(); j++) {{
+            const auto &x = unsigned_values[i], &y = unsigned_values[j];
+            assert((x < y) == (i < j) && (x <= y) == (i <= j));
+            assert((x > y) == (i > j) && (x >= y) == (i >= j));
+            assert((x == y) == (i == j) && (x != y) == (i != j));
+        }}
+    }}
+    for (size_t i = 0; i < signed_values.size(); i++) {{
+        for (size_t j = 0; j < signed_values.size(); j++) {{
+            const auto &x = signed_values[i], &y = signed_values[j];
+            assert((x < y) == (i < j) && (x <= y) == (i <= j));
+            assert((x > y) == (i > j) && (x >= y) == (i >= j));
+            assert((x == y) == (i == j) && (x != y) == (i != j));
+        }}
+    }}
+
+#ifdef SERDE_HAS_INT128
+    // Native integers convert losslessly and have the same encodings.
+    for (const auto &value : unsigned_values) {{
+        auto native = (serde::native_uint128_t)value;
+        assert(uint128_t(native) == value);
+        assert(encode(native) == encode(value));
+        assert(decode<serde::native_uint128_t>(encode(value)) == native);
+        assert(serde::hash_value(native) == serde::hash_value(value));
+    }}
+    for (const auto &value : signed_values) {{
+        auto native = (serde::native_int128_t)value;
+        assert(int128_t(native) == value);
+        assert(encode(native) == encode(value));
+        assert(decode<serde::native_int128_t>(encode(value)) == native);
+        assert(serde::hash_value(native) == serde::hash_value(value));
+    }}
+    assert((serde::native_int128_t)int128_t(-1, UINT64_MAX) == -1);
+    assert(int128_t(-2) == int128_t(-1, UINT64_MAX - 1));
+    assert((serde::native_uint128_t)uint128_t(1, 0) == (serde::native_uint128_t)UINT64_MAX + 1);
+
+    // Other numbers do not convert implicitly through native integers.
+    static_assert(!std::is_convertible_v<int, uint128_t>);
+    static_assert(!std::is_convertible_v<double, int128_t>);
+    static_assert(!std::is_convertible_v<serde::native_int128_t, uint128_t>);
+#endif
+    return 0;
+}}
+"#
+    );
+    run_cpp_test(None, &[], &source);
+}
+
+#[test]
+fn test_cpp_runtime_uleb128() {
+    let source = format!(
+        r#"
+#include <cassert>
+#include <string>
+#include "bcs.hpp"
+
+// Decode `input`, followed by `padding` bytes, with both the fast path and
+// the byte-by-byte path used at the end of the input.
+void check(std::vector<uint8_t> input, uint32_t expected, const char *error) {{
+    for (size_t padding : {{0, 4}}) {{
+        auto bytes = input;
+        bytes.insert(bytes.end(), padding, 0x80);
+        auto deserializer = serde::BcsDeserializer(bytes.data(), bytes.size());
+        try {{
+            auto value = deserializer.deserialize_variant_index();
+            assert(error == nullptr && value == expected);
+            assert(deserializer.get_buffer_offset() == input.size());
+        }} catch (serde::deserialization_error &e) {{
+            assert(error != nullptr && std::string(e.what()) == error);
+        }}
+    }}
+}}
+
+int main() {{
+    for (uint64_t value : {{0ull, 1ull, 127ull, 128ull, 300ull, 16383ull, 16384ull,
+                           2097151ull, 2097152ull, 268435455ull, 268435456ull,
+                           4294967295ull}}) {{
+        auto serializer = serde::BcsSerializer();
+        serializer.serialize_variant_index((uint32_t)value);
+        auto bytes = std::move(serializer).bytes();
+        assert(bytes.size() == serde::uleb128_length((uint32_t)value));
+        check(bytes, (uint32_t)value, nullptr);
+    }}
+    check({{0xac, 0x02}}, 300, nullptr);
+    check({{0xff, 0xff, 0xff, 0xff, 0x0f}}, 4294967295u, nullptr);
+
+    const char *zero_digit = "Invalid uleb128 number (unexpected zero digit)";
+    check({{0x80, 0x00}}, 0, zero_digit);
+    check({{0xff, 0x80, 0x80, 0x80, 0x00}}, 0, zero_digit);
+
+    const char *overflow = "Overflow while parsing uleb128-encoded uint32 value";
+    check({{0x80, 0x80, 0x80, 0x80, 0x10}}, 0, overflow);
+    check({{0xff, 0xff, 0xff, 0xff, 0xff}}, 0, overflow);
+    check({{0x80, 0x80, 0x80, 0x80, 0x80, 0x01}}, 0, overflow);
+
+    std::vector<uint8_t> truncated = {{0x80, 0x80}};
+    auto deserializer = serde::BcsDeserializer(truncated);
+    try {{
+        deserializer.deserialize_variant_index();
+        assert(false);
+    }} catch (serde::deserialization_error &e) {{
+        assert(std::string(e.what()) == "Input is not large enough");
+    }}
+    return 0;
+}}
+"#
+    );
+    run_cpp_test(None, &[], &source);
+}
+
+#[test]
+fn test_cpp_runtime_without_exceptions() {
+    let registry = test_utils::get_registry().unwrap();
+    let config = CodeGeneratorConfig::new("testing".to_string())
+        .with_encodings(vec![Runtime::Bcs.into(), Runtime::Bincode.into()]);
+
+    let positive_encodings: Vec<_> = Runtime::Bcs
+        .get_positive_samples()
+        .iter()
+        .map(|bytes| quote_bytes(bytes))
+        .collect();
+
+    let source = format!(
+        r#"
+#include <cassert>
+#include <cstring>
+#include "test.hpp"
+
+using namespace testing;
+
+int main() {{
+    std::vector<std::vector<uint8_t>> positive_inputs = {{{0}}};
+    for (auto input : positive_inputs) {{
+        auto result = SerdeData::bcsTryDeserialize(input);
+        assert(result.has_value());
+        assert(result->bcsSerialize() == input);
+
+        input.push_back(0);
+        result = SerdeData::bcsTryDeserialize(input);
+        assert(!result.has_value());
+        assert(strcmp(result.error().message, "Some input bytes were not read") == 0);
+        assert(result.error().offset == input.size() - 1);
+
+        input.resize(input.size() - 2);
+        assert(!SerdeData::bcsTryDeserialize(input).has_value());
+    }}
+
+    // Recursive types stop at the first error.
+    std::vector<uint8_t> input(10000, 1);
+    auto result = SimpleList::bcsTryDeserialize(input);
+    assert(!result.has_value());
+    assert(strcmp(result.error().message, "Too many nested containers") == 0);
+
+    // Leaving the containers restores the depth budget exactly.
+    auto deserializer = serde::BcsDeserializer(input);
+    deserializer.record_errors();
+    serde::Deserializable<SimpleList>::deserialize(deserializer);
+    assert(deserializer.has_failed());
+    assert(deserializer.has_container_depth_budget(serde::BCS_MAX_CONTAINER_DEPTH));
+    assert(!deserializer.has_container_depth_budget(serde::BCS_MAX_CONTAINER_DEPTH + 1));
+
+    // A failed key holds a null `value_ptr` (the tail of `List::Node`) and
+    // is not inserted: comparing it with the first key would dereference it.
+    // Both keys start with the `SerdeData` value read after an error.
+    std::vector<uint8_t> map_input = {{2, 1}};
+    map_input.resize(map_input.size() + 67);
+    map_input.insert(map_input.end(), {{0, 0, 1}});
+    auto map_deserializer = serde::BcsDeserializer(map_input);
+    auto map_result = serde::try_deserialize<std::map<List, uint8_t>>(map_deserializer);
+    assert(!map_result.has_value());
+    return 0;
+}}
+"#,
+        positive_encodings.join(", "),
+    );
+    run_cpp_test(Some((&registry, &config)), &["-fno-exceptions"], &source);
+}
+
+// `Pair` and `Leaf` are not recursive: their container depth is only tracked when they are
+// nested close to the limit, here inside the recursive type `Tree`.
+fn get_registry_with_bounded_types() -> Registry {
+    let mut registry = Registry::new();
+    registry.insert(
+        "Leaf".to_string(),
+        ContainerFormat::NewTypeStruct(Box::new(Format::U8)),
+    );
+    registry.insert(
+        "Pair".to_string(),
+        ContainerFormat::Struct(vec![Named {
+            name: "leaf".to_string(),
+            value: Format::TypeName("Leaf".to_string()),
+        }]),
+    );
+    let mut variants = BTreeMap::new();
+    variants.insert(
+        0,
+        Named {
+            name: "Leaf".to_string(),
+            value: VariantFormat::NewType(Box::new(Format::TypeName("Pair".to_string()))),
+        },
+    );
+    variants.insert(
+        1,
+        Named {
+            name: "Node".to_string(),
+            value: VariantFormat::NewType(Box::new(Format::TypeName("Tree".to_string()))),
+        },
+    );
+    registry.insert("Tree".to_string(), ContainerFormat::Enum(variants));
+    registry
+}
+
+#[test]
+fn test_cpp_runtime_container_depth_of_bounded_types() {
+    let registry = get_registry_with_bounded_types();
+    let config =
+        CodeGeneratorConfig::new("testing".to_string()).with_encodings(vec![Runtime::Bcs.into()]);
+
+    let source = format!(
+        r#"
+#include <cassert>
+#include <cstring>
+#include "test.hpp"
+
+using namespace testing;
+
+int main() {{
+    assert(Pair::bcsDeserialize(std::vector<uint8_t>{{7}}) == Pair{{Leaf{{7}}}});
+
+    // 497 nodes, then a leaf: 500 nested containers in total. `Pair` checks
+    // once that the remaining budget covers itself and `Leaf`.
+    std::vector<uint8_t> input(497, 1);
+    input.push_back(0);
+    input.push_back(7);
+    auto tree = Tree::bcsDeserialize(input);
+    assert(tree.bcsSerialize() == input);
+
+    input.insert(input.begin(), 1);
+    auto result = Tree::bcsTryDeserialize(input);
+    assert(!result.has_value());
+    assert(strcmp(result.error().message, "Too many nested containers") == 0);
+
+    Tree deeper_tree{{Tree::Node{{std::move(tree)}}}};
+    try {{
+        deeper_tree.bcsSerialize();
+        return 1;
+    }} catch (const serde::serialization_error &) {{
+    }}
+    return 0;
+}}
+"#
+    );
+    run_cpp_test(Some((&registry, &config)), &[], &source);
+}
+
+#[test]
+fn test_cpp_runtime_allocation_budget() {
+    let source = format!(
+        r#"
+#include <cassert>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include "bcs.hpp"
+
+using Value = std::map<uint8_t, std::vector<std::string>>;
+
+std::vector<uint8_t> encode(const Value &value) {{
+    auto serializer = serde::BcsSerializer();
+    serde::Serializable<Value>::serialize(value, serializer);
+    return std::move(serializer).bytes();
+}}
+
+int main() {{
+    Value value = {{{{1, {{"abc", "de"}}}}, {{2, {{std::string(100, 'x')}}}}}};
+    auto bytes = encode(value);
+
+    // Measure the cost of `value` with a large budget.
+    auto deserializer = serde::BcsDeserializer(bytes);
+    deserializer.set_allocation_budget(1000000);
+    assert(serde::Deserializable<Value>::deserialize(deserializer) == value);
+    size_t cost = 1000000 - deserializer.allocation_budget();
+    assert(cost >= 100 + 3 * sizeof(std::string));
+
+    // An exact budget is enough.
+    deserializer = serde::BcsDeserializer(bytes);
+    deserializer.set_allocation_budget(cost);
+    assert(serde::Deserializable<Value>::deserialize(deserializer) == value);
+    assert(deserializer.allocation_budget() == 0);
+
+    // A smaller one is not.
+    deserializer = serde::BcsDeserializer(bytes);
+    deserializer.set_allocation_budget(cost - 1);
+    try {{
+        serde::Deserializable<Value>::deserialize(deserializer);
+        assert(false);
+    }} catch (serde::allocation_budget_exceeded &e) {{
+        assert(std::string(e.what()) == "Allocation budget exceeded");
+    }}
+
+    deserializer = serde::BcsDeserializer(bytes);
+    deserializer.set_allocation_budget(cost - 1);
+    auto result = serde::try_deserialize<Value>(deserializer);
+    assert(!result);
+    assert(result.error().message == serde::allocation_budget_exceeded::message);
+
+    // Many small vectors, each under the length limit, add up.
+    std::vector<std::vector<uint64_t>> vectors(1000, std::vector<uint64_t>(100));
+    auto serializer = serde::BcsSerializer();
+    serde::Serializable<decltype(vectors)>::serialize(vectors, serializer);
+    bytes = std::move(serializer).bytes();
+    deserializer = serde::BcsDeserializer(bytes);
+    deserializer.set_allocation_budget(100000);
+    auto vectors_result =
+        serde::try_deserialize<decltype(vectors)>(deserializer);
+    assert(!vectors_result);
+    assert(vectors_result.error().message ==
+           serde::allocation_budget_exceeded::message);
+
+    // Lengths that the input cannot hold are rejected before being charged.
+    auto forged_serializer = serde::BcsSerializer();
+    forged_serializer.serialize_len(1000000);
+    forged_serializer.serialize_len(0);
+    bytes = std::move(forged_serializer).bytes();
+    deserializer = serde::BcsDeserializer(bytes);
+    deserializer.set_allocation_budget(1000);
+    vectors_result = serde::try_deserialize<decltype(vectors)>(deserializer);
+    assert(!vectors_result);
+    assert(strcmp(vectors_result.error().message, "Input is not large enough") == 0);
+    assert(deserializer.allocation_budget() == 1000);
+    return 0;
+}}
+"#
+    );
+    run_cpp_test(None, &[], &source);
+}
+
+#[test]
+fn test_cpp_runtime_deserialize_into() {
+    let source = format!(
+        r#"
+#include <cassert>
+#include <map>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+#include "bcs.hpp"
+
+using Entry = std::tuple<std::string, std::vector<uint64_t>>;
+using Value = std::map<std::string, std::vector<Entry>>;
+using Choice = std::variant<std::string, std::optional<serde::value_ptr<Value>>>;
+
+template <typename T>
+std::vector<uint8_t> encode(const T &value) {{
+    auto serializer = serde::BcsSerializer();
+    serde::Serializable<T>::serialize(value, serializer);
+    return std::move(serializer).bytes();
+}}
+
+int main() {{
+    std::string long_key(32, 'k');
+    Value value = {{
+        {{long_key + "1", {{{{long_key, {{1, 2, 3}}}}}}}},
+        {{long_key + "2", {{{{"", {{}}}}, {{long_key, {{4}}}}}}}},
+    }};
+    Value other = {{{{"a", {{{{long_key + long_key, {{5, 6, 7, 8}}}}}}}}}};
+
+    // Values of the same shape reuse all their memory.
+    Value result = value;
+    const char *key_data = result.begin()->first.data();
+    const uint64_t *numbers_data = std::get<1>(result.begin()->second[0]).data();
+    auto *entries_data = result.rbegin()->second.data();
+    auto bytes = encode(value);
+    auto deserializer = serde::BcsDeserializer(bytes);
+    deserializer.set_allocation_budget(0);
+    serde::deserialize_into(result, deserializer);
+    assert(result == value);
+    assert(result.begin()->first.data() == key_data);
+    assert(std::get<1>(result.begin()->second[0]).data() == numbers_data);
+    assert(result.rbegin()->second.data() == entries_data);
+
+    // Other values are overwritten, shrinking or growing containers.
+    for (auto *input : {{&other, &value, &other}}) {{
+        bytes = encode(*input);
+        deserializer = serde::BcsDeserializer(bytes);
+        serde::deserialize_into(result, deserializer);
+        assert(result == *input);
+    }}
+
+    // Variants and options are overwritten in place when they hold the same
+    // alternative.
+    Choice choice = std::optional<serde::value_ptr<Value>>(value);
+    const Value *pointee = std::get<1>(choice)->get();
+    bytes = encode(choice);
+    deserializer = serde::BcsDeserializer(bytes);
+    deserializer.set_allocation_budget(0);
+    serde::deserialize_into(choice, deserializer);
+    assert(std::get<1>(choice)->get() == pointee);
+    for (Choice input : {{Choice(long_key), Choice(std::nullopt),
+                          Choice(std::optional<serde::value_ptr<Value>>(other))}}) {{
+        bytes = encode(input);
+        deserializer = serde::BcsDeserializer(bytes);
+        serde::deserialize_into(choice, deserializer);
+        assert(choice == input);
+    }}
+
+    // Containers keep their memory when they shrink, for the next values.
+    std::vector<std::string> strings = {{long_key, long_key, long_key}};
+    auto *strings_data = strings.data();
+    size_t string_capacity = strings[0].capacity();
+    bytes = encode(std::vector<std::string>{{"a"}});
+    deserializer = serde::BcsDeserializer(bytes);
+    serde::deserialize_into(strings, deserializer);
+    assert(strings == std::vector<std::string>{{"a"}});
+    assert(strings.data() == strings_data && strings.capacity() >= 3);
+    assert(strings[0].capacity() == string_capacity);
+
+    // Errors are still reported.
+    bytes = encode(value);
+    bytes.pop_back();
+    deserializer = serde::BcsDeserializer(bytes);
+    try {{
+        serde::deserialize_into(result, deserializer);
+        assert(false);
+    }} catch (serde::deserialization_error &e) {{
+        assert(std::string(e.what()) == "Input is not large enough");
+    }}
+    return 0;
+}}
+"#
+    );
+    run_cpp_test(None, &[], &source);
+}
+
+#[test]
+fn test_cpp_runtime_comparison_of_external_definitions() {
+    let source = format!(
+        r#"
+#include <cassert>
+#include "bcs.hpp"
+
+// An external definition that does not specialize `EncodedComparison`.
+namespace pkg {{
+
+struct Struct {{
+    uint32_t x;
+    uint64_t y;
+}};
+
+}} // end of namespace pkg
+
+template <>
+template <typename Serializer>
+void serde::Serializable<pkg::Struct>::serialize(const pkg::Struct &value, Serializer &serializer) {{
+    serializer.serialize_u32(value.x);
+    serializer.serialize_u64(value.y);
+}}
+
+int main() {{
+    // External values are compared by serializing them: 256 is encoded as
+    // `00 01 00 00`, before 1 encoded as `01 00 00 00`.
+    auto lhs = pkg::Struct{{256, 0}};
+    auto rhs = pkg::Struct{{1, 0}};
+    assert(serde::compare_encodings(lhs, rhs) < 0);
+    assert(serde::compare_encodings(rhs, lhs) > 0);
+    assert(serde::compare_encodings(lhs, lhs) == 0);
+
+    // Containers of external values follow the same order.
+    using Value = std::tuple<std::vector<pkg::Struct>, std::optional<pkg::Struct>>;
+    auto lhs_value = Value{{{{lhs}}, std::nullopt}};
+    auto rhs_value = Value{{{{rhs}}, std::nullopt}};
+    assert(serde::compare_encodings(lhs_value, rhs_value) < 0);
+    assert(serde::compare_encodings(lhs_value, Value{{{{lhs}}, rhs}}) < 0);
+    return 0;
+}}
+"#
+    );
+    run_cpp_test(None, &[], &source);
+}
+
+#[test]
+fn test_cpp_runtime_polymorphic_allocators() {
+    let source = format!(
+        r#"
+#include <cassert>
+#include "bcs.hpp"
+
+#ifdef SERDE_HAS_PMR
+using Item = std::tuple<std::pmr::string, std::optional<std::pmr::vector<uint16_t>>>;
+using Value = std::pmr::map<std::pmr::string,
+    std::variant<std::array<Item, 2>, serde::pmr::value_ptr<Item>>>;
+
+int main() {{
+    std::pmr::string long_string(100, 'x');
+    Value value;
+    value[long_string] = std::array<Item, 2>{{{{
+        {{long_string, std::pmr::vector<uint16_t>{{1, 2, 3}}}},
+        {{"", std::nullopt}},
+    }}}};
+    value["b"] = serde::pmr::value_ptr<Item>(Item{{long_string, std::nullopt}});
+    auto serializer = serde::BcsSerializer();
+    serde::Serializable<Value>::serialize(value, serializer);
+    auto bytes = std::move(serializer).bytes();
+
+    // All the memory comes from the arena.
+    std::pmr::monotonic_buffer_resource arena;
+    auto default_resource = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+    auto deserializer = serde::BcsDeserializer(bytes);
+    deserializer.set_memory_resource(&arena);
+    auto result = serde::Deserializable<Value>::deserialize(deserializer);
+    std::pmr::set_default_resource(default_resource);
+    assert(result == value);
+    assert(result.get_allocator().resource() == &arena);
+    return 0;
+}}
+#else
+int main() {{
+    return 0;
+}}
+#endif
+"#
+    );
+    run_cpp_test(None, &[], &source);
 }